@@ -0,0 +1,169 @@
+/*
+ * asm-benches.cpp
+ *
+ * Benchmarking an arbitrary assembly snippet given on the command line with --asm: the snippet is assembled at
+ * runtime with nasm (by default the one vendored in nasm-2.13.03) into a flat binary, wrapped in the usual
+ * benchmark loop, loaded into executable memory with the jit helpers and timed like any other benchmark.
+ *
+ * In the snippet, rdi is the loop counter and must not be modified, and rsi points to a zeroed ASM_BUFFER_SIZE
+ * buffer which may be used freely. All other general purpose and vector registers may be clobbered.
+ */
+
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "benchmark.hpp"
+#include "context.hpp"
+#include "util.hpp"
+#include "jit.hpp"
+#include "isa-support.hpp"
+#include "simple-timer.hpp"
+
+using namespace std;
+
+/* the size of the scratch buffer pointed to by rsi */
+constexpr size_t ASM_BUFFER_SIZE = 64 * 1024;
+
+/* the nasm to use: the configured one, the vendored one next to this binary, or the one on the PATH */
+static string nasm_path(const string& configured) {
+    if (!configured.empty()) {
+        return configured;
+    }
+    char exe[4096];
+    ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (len > 0) {
+        string dir(exe, len);
+        string vendored = dir.substr(0, dir.rfind('/')) + "/nasm-2.13.03/nasm";
+        if (access(vendored.c_str(), X_OK) == 0) {
+            return vendored;
+        }
+    }
+    return "nasm";
+}
+
+/*
+ * The complete source for a snippet: the snippet repeated repeat times in a loop of rdi iterations, which saves and
+ * restores the callee-saved registers the snippet might clobber.
+ */
+static string snippet_source(const string& snippet, unsigned repeat) {
+    string body = snippet;
+    std::replace(body.begin(), body.end(), ';', '\n');
+    std::ostringstream s;
+    s << "BITS 64\n"
+      << "default rel\n"
+      << "push rbx\npush rbp\npush r12\npush r13\npush r14\npush r15\n"
+      << "ALIGN 64\n"
+      << "top:\n"
+      << "%rep " << repeat << "\n"
+      << "%line 1+1 --asm\n"
+      << body << "\n"
+      << "%endrep\n"
+      << "dec rdi\n"
+      << "jnz top\n"
+      << (supports({AVX}) ? "vzeroupper\n" : "")
+      << "pop r15\npop r14\npop r13\npop r12\npop rbp\npop rbx\n"
+      << "ret\n";
+    return s.str();
+}
+
+/* assemble source as a flat binary, throwing with nasm's output if it fails */
+static vector<uint8_t> assemble(const string& nasm, const string& source) {
+    char dir[] = "/tmp/uarch-bench-asm-XXXXXX";
+    if (!mkdtemp(dir)) {
+        throw std::runtime_error("mkdtemp failed while assembling the --asm snippet: " + errno_to_str(errno));
+    }
+    string src = string(dir) + "/snippet.asm", bin = string(dir) + "/snippet.bin";
+    std::ofstream(src) << source;
+
+    string command = "'" + nasm + "' -f bin -o '" + bin + "' '" + src + "' 2>&1";
+    FILE *p = popen(command.c_str(), "r");
+    if (!p) {
+        throw std::runtime_error("failed to run " + nasm + ": " + errno_to_str(errno));
+    }
+    string output;
+    char buf[256];
+    while (fgets(buf, sizeof(buf), p)) {
+        output += buf;
+    }
+    int status = pclose(p);
+
+    std::ifstream in(bin, std::ios::binary);
+    vector<uint8_t> code((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    unlink(src.c_str());
+    unlink(bin.c_str());
+    rmdir(dir);
+
+    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || code.empty()) {
+        throw std::runtime_error("assembling the --asm snippet with " + nasm + " failed:\n" + output);
+    }
+    return code;
+}
+
+/*
+ * A group with no registered benchmarks, which makes and runs the benchmark for the --asm snippet, if any, when run.
+ * The benchmark is made at that point because its ops and description depend on the command line.
+ */
+class AsmGroup : public BenchmarkGroup {
+    std::function<Benchmark(uint32_t ops, const string& desc)> factory_;
+    JitCall call_;
+
+public:
+    AsmGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    template <typename TIMER>
+    static shared_ptr<AsmGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<AsmGroup>(id, desc);
+        AsmGroup* g = group.get();
+        auto maker = DeltaMaker<TIMER>(g, 1000);
+        g->factory_ = [g, maker](uint32_t ops, const string& desc) mutable {
+            return maker.template make_only<jit_call>("snippet", desc, ops, [g]{ return &g->call_; });
+        };
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        if (!c.hasAsm()) {
+            return;
+        }
+        SimpleTimer timer;
+        unsigned repeat = c.getAsmRepeat();
+        if (repeat == 0) {
+            c.fatal("--repeat must be at least 1");
+        }
+        Benchmark b = factory_(repeat, c.getAsm());
+        if (!predicate(b)) {
+            return;
+        }
+
+        jit::Emitter e;
+        e.bytes(assemble(nasm_path(c.getNasmPath()), snippet_source(c.getAsm(), repeat)));
+        call_.code = e.finish();
+        static void *buffer = aligned_ptr(4096, ASM_BUFFER_SIZE, false);
+        std::memset(buffer, 0, ASM_BUFFER_SIZE);
+        call_.arg = buffer;
+
+        c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+        printGroupHeader(c);
+        TimingResult result = b->run(c.getTimerInfo());
+        printResultLine(c, b, result);
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+};
+
+template <typename TIMER>
+void register_asm(GroupList& list) {
+    list.push_back(AsmGroup::make<TIMER>("asm", "The --asm snippet, per copy"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_asm<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -0,0 +1,84 @@
+/*
+ * atomic-benches.cpp
+ *
+ * Latency and throughput of locked instructions, xchg and mfence, both uncontended and contended by several
+ * threads hammering the same line.
+ */
+
+#include "benchmark.hpp"
+#include "contended.hpp"
+#include "util.hpp"
+
+extern "C" {
+bench2_f dep_lock_add;
+bench2_f indep_lock_add;
+bench2_f dep_lock_xadd;
+bench2_f indep_lock_xadd;
+bench2_f dep_xchg;
+bench2_f indep_xchg;
+bench2_f dep_cmpxchg_success;
+bench2_f indep_cmpxchg_success;
+bench2_f dep_cmpxchg_fail;
+bench2_f indep_cmpxchg_fail;
+bench2_f dep_cmpxchg16b;
+bench2_f indep_cmpxchg16b;
+bench2_f mfence_only;
+}
+
+/* the number of lines the independent variants spread their operations over */
+constexpr size_t ATOMIC_LINES = 4;
+
+/*
+ * Return the 4 lines targeted by the atomic benchmarks, which no other benchmark uses. The kernels don't depend on
+ * their contents (see x86_methods.asm), so nothing resets them between benchmarks.
+ */
+static void *atomic_lines() {
+    alignas(64) static char lines[ATOMIC_LINES * 64];
+    return lines;
+}
+
+template <typename TIMER>
+void register_atomics(GroupList& list) {
+    {
+        std::shared_ptr<BenchmarkGroup> group = std::make_shared<BenchmarkGroup>("atomics", "Atomic operations, uncontended");
+        list.push_back(group);
+
+        auto maker = DeltaMaker<TIMER>(group.get(), 1000);
+
+        maker.template make<dep_lock_add>         ("dep-lock-add",          "Dependent lock add",                   8, atomic_lines);
+        maker.template make<indep_lock_add>       ("indep-lock-add",        "Independent lock add",                 8, atomic_lines);
+        maker.template make<dep_lock_xadd>        ("dep-lock-xadd",         "Dependent lock xadd",                  8, atomic_lines);
+        maker.template make<indep_lock_xadd>      ("indep-lock-xadd",       "Independent lock xadd",                8, atomic_lines);
+        maker.template make<dep_xchg>             ("dep-xchg",              "Dependent xchg",                       8, atomic_lines);
+        maker.template make<indep_xchg>           ("indep-xchg",            "Independent xchg",                     8, atomic_lines);
+        maker.template make<dep_cmpxchg_success>  ("dep-cmpxchg-success",   "Dependent lock cmpxchg (success)",     8, atomic_lines);
+        maker.template make<indep_cmpxchg_success>("indep-cmpxchg-success", "Independent lock cmpxchg (success)",   8, atomic_lines);
+        maker.template make<dep_cmpxchg_fail>     ("dep-cmpxchg-fail",      "Dependent lock cmpxchg (failure)",     8, atomic_lines);
+        maker.template make<indep_cmpxchg_fail>   ("indep-cmpxchg-fail",    "Independent lock cmpxchg (failure)",   8, atomic_lines);
+        maker.template make<mfence_only>          ("mfence",                "Back-to-back mfence",                  8, atomic_lines);
+
+        auto maker16 = maker.setFeatures({CX16});
+        maker16.template make<dep_cmpxchg16b>     ("dep-cmpxchg16b",        "Dependent lock cmpxchg16b (success)",  8, atomic_lines);
+        maker16.template make<indep_cmpxchg16b>   ("indep-cmpxchg16b",      "Independent lock cmpxchg16b (success)",8, atomic_lines);
+    }
+
+    {
+        // every thread targets the same line
+        auto group = std::make_shared<ContendedGroup>("atomics/contended", "Atomic operations on one line, contended");
+        list.push_back(group);
+
+        auto maker = DeltaMaker<TIMER>(group.get(), 1000).setTags({"slow"});
+        auto same_line = [](size_t thread) { return atomic_lines(); };
+
+        group->add<dep_lock_add>       (maker, "lock-add",         "Contended lock add",                  8, same_line);
+        group->add<dep_lock_xadd>      (maker, "lock-xadd",        "Contended lock xadd",                 8, same_line);
+        group->add<dep_xchg>           (maker, "xchg",             "Contended xchg",                      8, same_line);
+        group->add<dep_cmpxchg_success>(maker, "cmpxchg-success",  "Contended lock cmpxchg (success)",    8, same_line);
+        group->add<dep_cmpxchg_fail>   (maker, "cmpxchg-fail",     "Contended lock cmpxchg (failure)",    8, same_line);
+        group->add<dep_cmpxchg16b>     (maker.setFeatures({CX16}), "cmpxchg16b", "Contended lock cmpxchg16b (success)", 8, same_line);
+    }
+}
+
+#define REG_DEFAULT(CLOCK) template void register_atomics<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -27,6 +27,10 @@ void printResultLine(Context& c, const Benchmark& b, const TimingResult& result)
     std::ostream& os = c.out();
     printBenchName(c, b);
     printAlignedMetrics(c, result.getResults());
+    std::string note = c.getTimerInfo().annotate(result);
+    if (!note.empty()) {
+        os << "   " << note;
+    }
     os << endl;
 }
 
@@ -21,6 +21,7 @@
 #include "timers.hpp"
 #include "context.hpp"
 #include "isa-support.hpp"
+#include "cache-state.hpp"
 
 #if defined(__GNUC__) && !defined(__clang__)
 #define NO_STACK_PROTECTOR __attribute__((optimize("no-stack-protector")))
@@ -273,8 +274,22 @@ public:
 
 
     virtual TimingResult run(const TimerInfo& ti) override {
-        raw_result raw = get_raw();
-        return handle_raw(raw, ti);
+        unsigned passes = ti.getPassCount();
+        if (passes == 1) {
+            raw_result raw = get_raw();
+            return handle_raw(raw, ti);
+        }
+        // cycles from the first pass, followed by the other metrics of each pass
+        std::vector<double> merged;
+        for (unsigned pass = 0; pass < passes; pass++) {
+            ti.setPass(pass);
+            raw_result raw = get_raw();
+            TimingResult result = handle_raw(raw, ti);
+            auto& results = result.getResults();
+            merged.insert(merged.end(), results.begin() + (pass == 0 ? 0 : 1), results.end());
+        }
+        ti.setPass(0);
+        return TimingResult(std::move(merged));
     }
 
     virtual void runAndPrintInner(Context& c) override {
@@ -328,11 +343,12 @@ struct DeltaAlgo {
     typedef raw_result (raw_f)(size_t loop_count, void *arg);
 
 
-    template <bench2_f BENCH_METHOD, bench2_f BASE_METHOD>
+    /* WARM_EVERY runs before each sample of BENCH_METHOD, e.g., to put its region into a given cache state */
+    template <bench2_f BENCH_METHOD, bench2_f BASE_METHOD, bench2_f WARM_EVERY = inlined_empty>
     static raw_result delta_bench(size_t loop_count, void *arg) {
         raw_result result;
         result.base  = time_one<TIMER, total_samples, BASE_METHOD> (loop_count, arg);
-        result.bench = time_one<TIMER, total_samples, BENCH_METHOD>(loop_count, arg);
+        result.bench = time_one<TIMER, total_samples, BENCH_METHOD, inlined_empty, WARM_EVERY>(loop_count, arg);
         return result;
     }
 
@@ -425,16 +441,30 @@ public:
  */
 template <typename TIMER>
 class DeltaMaker : public MakerBase<TIMER, DeltaMaker<TIMER>> {
+    CacheState cache_state;
+
 public:
 
     using base_t = MakerBase<TIMER, DeltaMaker<TIMER>>;
 
     DeltaMaker(const DeltaMaker& ) = default;
-    DeltaMaker(BenchmarkGroup* parent, uint32_t loop_count = default_loop_count) : base_t(parent, loop_count) {}
+    DeltaMaker(BenchmarkGroup* parent, uint32_t loop_count = default_loop_count) : base_t(parent, loop_count),
+            cache_state{CacheState::ANY} {}
 
     static constexpr uint32_t default_loop_count = 10000;
     static constexpr int                 samples =    33;
 
+    /**
+     * Returns a COPY of this object which puts the benchmark region into the given cache state (untimed) before
+     * each sample, rather than leaving it however the previous sample or benchmark left it. The benchmark arg
+     * must be a region* (e.g., from shuffled_region()) for any state other than ANY.
+     */
+    DeltaMaker setCacheState(CacheState cache_state) {
+        DeltaMaker ret(*this);
+        ret.cache_state = cache_state;
+        return ret;
+    }
+
     /**
      * Makes a benchmark with the given BASE_METHOD and BENCH_METHOD, and adds it to the group associated with
      * this maker object.
@@ -457,7 +487,15 @@ public:
             uint32_t ops_per_loop,
             const arg_provider_t& arg_provider = null_provider)
     {
-        typename BenchTemplate<TIMER, DeltaAlgo<TIMER>>::raw_f *f = DeltaAlgo<TIMER>::template delta_bench<BENCH_METHOD, BASE_METHOD>;
+        using algo = DeltaAlgo<TIMER>;
+        typename BenchTemplate<TIMER, algo>::raw_f *f;
+        switch (this->cache_state) {
+        case CacheState::FLUSHED: f = algo::template delta_bench<BENCH_METHOD, BASE_METHOD, cache_state_flushed>; break;
+        case CacheState::L1:      f = algo::template delta_bench<BENCH_METHOD, BASE_METHOD, cache_state_l1>;      break;
+        case CacheState::L2:      f = algo::template delta_bench<BENCH_METHOD, BASE_METHOD, cache_state_l2>;      break;
+        case CacheState::LLC:     f = algo::template delta_bench<BENCH_METHOD, BASE_METHOD, cache_state_llc>;     break;
+        default:                  f = algo::template delta_bench<BENCH_METHOD, BASE_METHOD>;
+        }
         return base_t::template make_bench_from_raw<DeltaAlgo<TIMER>>(id, description, ops_per_loop, f, arg_provider);
     }
 };
@@ -522,6 +560,33 @@ void register_oneshot(GroupList& list);
 template <typename TIMER>
 void register_syscall(GroupList& list);
 
+template <typename TIMER>
+void register_thread(GroupList& list);
+
+template <typename TIMER>
+void register_atomics(GroupList& list);
+
+template <typename TIMER>
+void register_instructions(GroupList& list);
+
+template <typename TIMER>
+void register_timeline(GroupList& list);
+
+template <typename TIMER>
+void register_branch(GroupList& list);
+
+template <typename TIMER>
+void register_frontend(GroupList& list);
+
+template <typename TIMER>
+void register_smc(GroupList& list);
+
+/* the path of the benchmark for the --asm snippet */
+constexpr const char *ASM_SNIPPET_PATH = "asm/snippet";
+
+template <typename TIMER>
+void register_asm(GroupList& list);
+
 void printResultHeader(Context& c, const TimerInfo& ti);
 
 
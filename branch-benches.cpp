@@ -0,0 +1,408 @@
+/*
+ * branch-benches.cpp
+ *
+ * Limits of the branch predictors, using kernels generated at runtime by the jit emitter:
+ *
+ * branch/pattern: a single conditional branch whose direction follows a fixed random pattern with the given period.
+ * The period at which the branch starts to mispredict shows how long a pattern the predictor can learn for one
+ * branch (i.e., how much useful history it keeps).
+ *
+ * branch/btb: the given number of static conditional branches in sequence, each always going the same way. The
+ * count at which they get slower shows the capacity of the BTB (which taken branches need an entry in) and of the
+ * direction predictor. The branches are BRANCH_BTB_STRIDE bytes apart, so the largest counts also outgrow the L1I.
+ *
+ * In both, the other axis is the taken density: the fraction of the pattern, or of the static branches, which is
+ * taken.
+ *
+ * branch/indirect: a single indirect jmp (as in an interpreter using indirect threading) which cycles through the
+ * given number of targets in a fixed random pattern with the given period, i.e., a map of how many targets, and how
+ * long a pattern of them, one indirect branch can predict.
+ *
+ * branch/indirect-sites: the given number of indirect call sites (as in virtual dispatch), each always calling the
+ * same function, i.e., the capacity for monomorphic indirect branches.
+ *
+ * All results are per branch under test. Add BR_MISP_RETIRED.ALL_BRANCHES with --extra-events (perf or libpfc
+ * timers) to see the mispredicts per branch, which are then also summarized.
+ */
+
+#include <random>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "jit.hpp"
+#include "table.hpp"
+#include "simple-timer.hpp"
+
+using namespace std;
+using namespace jit;
+
+constexpr size_t BRANCH_MAX_PERIOD = 4096;
+constexpr int    BRANCH_PATTERN_DENSITY[] = {10, 50, 90};
+constexpr size_t BRANCH_MAX_COUNT = 16384;
+constexpr int    BRANCH_BTB_DENSITY[] = {50, 100};
+/* the distance in bytes between consecutive branches in branch/btb */
+constexpr int    BRANCH_BTB_STRIDE = 8;
+/* the total branches per sample in branch/btb and branch/indirect-sites, spread over as many iterations as needed */
+constexpr size_t BRANCH_BTB_TOTAL = 1 << 18;
+constexpr size_t BRANCH_MAX_TARGETS = 4096;
+constexpr size_t BRANCH_MAX_SITES = 16384;
+/* the distance in bytes between consecutive indirect targets, or call sites */
+constexpr int    BRANCH_INDIRECT_STRIDE = 8;
+
+/* the metric with the mispredicts, if requested: the (truncated) header of BR_MISP_RETIRED.* */
+static const string BRANCH_MISP_HEADER = "BR_MIS";
+
+/*
+ * Return size outcomes (1 is taken) of which density percent (to the nearest whole outcome) are taken, in a random
+ * but fixed order.
+ */
+static vector<uint8_t> branch_outcomes(size_t size, int density) {
+    vector<uint8_t> ret(size, 0);
+    size_t taken = std::lround(size * density / 100.0);
+    std::fill(ret.begin(), ret.begin() + taken, 1);
+    std::shuffle(ret.begin(), ret.end(), std::mt19937_64{123});
+    return ret;
+}
+
+/* the arg for the branch/pattern kernel: the pattern, and the position reached so far, which persists across calls */
+struct BranchPattern {
+    const uint8_t *start, *end, *pos;
+};
+
+/*
+ * One iteration loads the next outcome of the pattern (wrapping around at the end with a cmov, so the pattern
+ * branch is the only conditional branch other than the loop branch) and branches on it.
+ */
+static Emitter emit_pattern() {
+    Emitter e;
+    e.mov(R9, ptr(RSI, offsetof(BranchPattern, start)));
+    e.mov(R8, ptr(RSI, offsetof(BranchPattern, end)));
+    e.mov(RCX, ptr(RSI, offsetof(BranchPattern, pos)));
+    loop(e, [](Emitter& e) {
+        e.movzxb(RAX, ptr(RCX));
+        e.add(RCX, 1);
+        e.cmp(RCX, R8);
+        e.cmovae(RCX, R9);
+        e.test(RAX, RAX);
+        Fixup skip = e.jnz_forward();
+        e.add(RDX, 1);
+        e.bind(skip);
+    });
+    e.mov(ptr(RSI, offsetof(BranchPattern, pos)), RCX);
+    e.ret();
+    return e;
+}
+
+/*
+ * One iteration runs count branches, BRANCH_BTB_STRIDE bytes apart: jz for the taken ones and jnz for the others,
+ * after a zeroing xor, so either way execution continues at the next branch.
+ */
+static Emitter emit_btb(size_t count, int density) {
+    vector<uint8_t> taken = branch_outcomes(count, density);
+    Emitter e;
+    loop(e, [&](Emitter& e) {
+        e.xor_(RAX, RAX);
+        for (size_t i = 0; i < count; i++) {
+            Fixup next = taken[i] ? e.jz_forward() : e.jnz_forward();
+            e.nop(BRANCH_BTB_STRIDE - 2);
+            e.bind(next);
+        }
+    });
+    e.ret();
+    return e;
+}
+
+/* the arg for the branch/indirect kernel: the pattern of target addresses, and the position reached so far */
+struct IndirectPattern {
+    void * const *start, * const *end, * const *pos;
+};
+
+/* emit pad bytes of nops to fill a slot of BRANCH_INDIRECT_STRIDE bytes which started at the given size */
+static void pad_slot(Emitter& e, size_t start) {
+    assert(e.size() - start <= (size_t)BRANCH_INDIRECT_STRIDE);
+    e.nop(BRANCH_INDIRECT_STRIDE - (e.size() - start));
+}
+
+/*
+ * One iteration loads the next target from the pattern (wrapping as in emit_pattern) and jumps to it, and every
+ * target jumps straight back. The labels of the targets are added to stubs.
+ */
+static Emitter emit_indirect(size_t targets, vector<Label>& stubs) {
+    Emitter e;
+    e.mov(R9, ptr(RSI, offsetof(IndirectPattern, start)));
+    e.mov(R8, ptr(RSI, offsetof(IndirectPattern, end)));
+    e.mov(RCX, ptr(RSI, offsetof(IndirectPattern, pos)));
+    Label cont = {};
+    loop(e, [&](Emitter& e) {
+        e.mov(RAX, ptr(RCX));
+        e.add(RCX, 8);
+        e.cmp(RCX, R8);
+        e.cmovae(RCX, R9);
+        e.jmp(RAX);
+        cont = e.here();
+    });
+    e.mov(ptr(RSI, offsetof(IndirectPattern, pos)), RCX);
+    e.ret();
+    for (size_t i = 0; i < targets; i++) {
+        size_t start = e.size();
+        stubs.push_back(e.here());
+        e.jmp(cont);
+        pad_slot(e, start);
+    }
+    return e;
+}
+
+/*
+ * One iteration makes sites indirect calls, each through its own entry in the table rsi points to, to its own
+ * function which just returns. The labels of the functions are added to stubs.
+ */
+static Emitter emit_sites(size_t sites, vector<Label>& stubs) {
+    Emitter e;
+    loop(e, [=](Emitter& e) {
+        for (size_t i = 0; i < sites; i++) {
+            size_t start = e.size();
+            e.call(ptr(RSI, i * 8));
+            pad_slot(e, start);
+        }
+    });
+    e.ret();
+    for (size_t i = 0; i < sites; i++) {
+        size_t start = e.size();
+        stubs.push_back(e.here());
+        e.ret();
+        pad_slot(e, start);
+    }
+    return e;
+}
+
+/*
+ * Runs the benchmarks for each point, then prints the cycles (and mispredicts, if counted) per branch with a row
+ * per period or count and a column per value of the other axis (e.g., the taken density).
+ */
+class BranchSweepGroup : public BenchmarkGroup {
+    struct Point {
+        size_t x;
+        string column;
+    };
+
+    /* the name of the swept quantity, e.g., "Period" */
+    string axis_;
+    /* parallel to getBenches() */
+    vector<Point> points_;
+
+public:
+    BranchSweepGroup(const string& id, const string& desc, const string& axis) : BenchmarkGroup(id, desc), axis_{axis} {}
+
+    template <typename TIMER>
+    static shared_ptr<BranchSweepGroup> make_pattern(const string& id, const string& desc) {
+        auto group = make_shared<BranchSweepGroup>(id, desc, "Period");
+        auto maker = DeltaMaker<TIMER>(group.get(), 16 * BRANCH_MAX_PERIOD);
+        for (int density : BRANCH_PATTERN_DENSITY) {
+            for (size_t period = 1; period <= BRANCH_MAX_PERIOD; period *= 2) {
+                // the code and the pattern are generated when the benchmark first runs, not at startup
+                auto call = make_shared<JitCall>();
+                auto pattern = make_shared<BranchPattern>();
+                auto outcomes = make_shared<vector<uint8_t>>();
+                maker.template make<jit_call>(
+                        string_format("period-%zu-taken-%d", period, density),
+                        string_format("period %zu, %d%% taken", period, density),
+                        1,
+                        [=]{
+                            static shared_ptr<Code> code = emit_pattern().finish();
+                            if (outcomes->empty()) {
+                                *outcomes = branch_outcomes(period, density);
+                                pattern->start = pattern->pos = outcomes->data();
+                                pattern->end = pattern->start + period;
+                            }
+                            call->code = code;
+                            call->arg = pattern.get();
+                            return call.get();
+                        });
+                group->points_.push_back({period, std::to_string(density) + "% taken"});
+            }
+        }
+        return group;
+    }
+
+    template <typename TIMER>
+    static shared_ptr<BranchSweepGroup> make_btb(const string& id, const string& desc) {
+        auto group = make_shared<BranchSweepGroup>(id, desc, "Branches");
+        auto maker = DeltaMaker<TIMER>(group.get());
+        for (int density : BRANCH_BTB_DENSITY) {
+            for (size_t count = 1; count <= BRANCH_MAX_COUNT; count *= 2) {
+                auto call = make_shared<JitCall>();
+                maker.setLoopCount(std::max(BRANCH_BTB_TOTAL / count, (size_t)16)).template make<jit_call>(
+                        string_format("branches-%zu-taken-%d", count, density),
+                        string_format("%zu branches, %d%% taken", count, density),
+                        count,
+                        [=]{
+                            if (!call->code) {
+                                call->code = emit_btb(count, density).finish();
+                            }
+                            return call.get();
+                        });
+                group->points_.push_back({count, std::to_string(density) + "% taken"});
+            }
+        }
+        return group;
+    }
+
+    template <typename TIMER>
+    static shared_ptr<BranchSweepGroup> make_indirect(const string& id, const string& desc) {
+        auto group = make_shared<BranchSweepGroup>(id, desc, "Period");
+        auto maker = DeltaMaker<TIMER>(group.get(), 16 * BRANCH_MAX_PERIOD);
+        for (size_t targets = 1; targets <= BRANCH_MAX_TARGETS; targets *= 2) {
+            // every target appears in the pattern, so the period is at least the number of targets
+            for (size_t period = targets; period <= BRANCH_MAX_PERIOD; period *= 2) {
+                auto call = make_shared<JitCall>();
+                auto pattern = make_shared<IndirectPattern>();
+                auto addresses = make_shared<vector<void *>>();
+                maker.template make<jit_call>(
+                        string_format("targets-%zu-period-%zu", targets, period),
+                        string_format("%zu targets, period %zu", targets, period),
+                        1,
+                        [=]{
+                            if (!call->code) {
+                                vector<Label> stubs;
+                                call->code = emit_indirect(targets, stubs).finish();
+                                vector<size_t> order(period);
+                                for (size_t i = 0; i < period; i++) {
+                                    order[i] = i % targets;
+                                }
+                                std::shuffle(order.begin(), order.end(), std::mt19937_64{123});
+                                for (size_t t : order) {
+                                    addresses->push_back(call->code->at(stubs[t]));
+                                }
+                                pattern->start = pattern->pos = addresses->data();
+                                pattern->end = pattern->start + period;
+                                call->arg = pattern.get();
+                            }
+                            return call.get();
+                        });
+                group->points_.push_back({period, std::to_string(targets) + " targets"});
+            }
+        }
+        return group;
+    }
+
+    template <typename TIMER>
+    static shared_ptr<BranchSweepGroup> make_sites(const string& id, const string& desc) {
+        auto group = make_shared<BranchSweepGroup>(id, desc, "Sites");
+        auto maker = DeltaMaker<TIMER>(group.get());
+        for (size_t sites = 1; sites <= BRANCH_MAX_SITES; sites *= 2) {
+            auto call = make_shared<JitCall>();
+            auto table = make_shared<vector<void *>>();
+            maker.setLoopCount(std::max(BRANCH_BTB_TOTAL / sites, (size_t)16)).template make<jit_call>(
+                    string_format("sites-%zu", sites),
+                    string_format("%zu indirect call sites", sites),
+                    sites,
+                    [=]{
+                        if (!call->code) {
+                            vector<Label> stubs;
+                            call->code = emit_sites(sites, stubs).finish();
+                            for (auto& stub : stubs) {
+                                table->push_back(call->code->at(stub));
+                            }
+                            call->arg = table->data();
+                        }
+                        return call.get();
+                    });
+            group->points_.push_back({sites, "fixed target"});
+        }
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == points_.size());
+
+        auto& names = c.getTimerInfo().getMetricNames();
+        size_t misp = std::find_if(names.begin(), names.end(),
+                [](const string& n){ return n.compare(0, BRANCH_MISP_HEADER.size(), BRANCH_MISP_HEADER) == 0; }) - names.begin();
+
+        bool header = false;
+        vector<double> cycles(points_.size(), NAN), mispredicts(points_.size(), NAN);
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b)) {
+                continue;
+            }
+            if (!header) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                printGroupHeader(c);
+                header = true;
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            cycles[i] = result.getCycles();
+            if (misp < result.getResults().size()) {
+                mispredicts[i] = result.getResults()[misp];
+            }
+        }
+
+        if (!header) {
+            return;
+        }
+
+        printSummary(c, "Cycles per branch", cycles);
+        if (misp < names.size()) {
+            printSummary(c, "Mispredicts per branch (" + names[misp] + ")", mispredicts);
+        }
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+
+    void printSummary(Context& c, const string& title, const vector<double>& values) {
+        using namespace table;
+        vector<string> columns;
+        vector<size_t> xs;
+        for (auto& p : points_) {
+            if (std::find(columns.begin(), columns.end(), p.column) == columns.end()) {
+                columns.push_back(p.column);
+            }
+            if (std::find(xs.begin(), xs.end(), p.x) == xs.end()) {
+                xs.push_back(p.x);
+            }
+        }
+        std::sort(xs.begin(), xs.end());
+
+        Table t;
+        auto& header = t.newRow().add(axis_);
+        for (size_t i = 0; i < columns.size(); i++) {
+            header.add(columns[i]);
+            t.colInfo(i + 1).justify = ColInfo::RIGHT;
+        }
+        for (size_t x : xs) {
+            auto& row = t.newRow().add(x);
+            for (auto& column : columns) {
+                double v = NAN;
+                for (size_t i = 0; i < points_.size(); i++) {
+                    if (points_[i].x == x && points_[i].column == column) {
+                        v = values[i];
+                    }
+                }
+                row.add(std::isnan(v) ? string("-") : string_format("%.2f", v));
+            }
+        }
+        c.out() << endl << title << ":" << endl << t.str();
+    }
+};
+
+template <typename TIMER>
+void register_branch(GroupList& list) {
+    list.push_back(BranchSweepGroup::make_pattern<TIMER>("branch/pattern",
+            "Conditional branch pattern period sweep"));
+    list.push_back(BranchSweepGroup::make_btb<TIMER>("branch/btb",
+            "Static conditional branch count sweep"));
+    list.push_back(BranchSweepGroup::make_indirect<TIMER>("branch/indirect",
+            "Indirect jmp target count and pattern period sweep"));
+    list.push_back(BranchSweepGroup::make_sites<TIMER>("branch/indirect-sites",
+            "Monomorphic indirect call site count sweep"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_branch<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -0,0 +1,83 @@
+/*
+ * cache-state.cpp
+ */
+
+#include "cache-state.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+
+#include <immintrin.h>
+#include <unistd.h>
+
+/* the eviction buffers are this many times the size of the cache they evict, to defeat non-LRU replacement */
+constexpr size_t EVICT_FACTOR = 2;
+
+static size_t cache_size(int name, size_t fallback) {
+    long size = sysconf(name);
+    return size > 0 ? size : fallback;
+}
+
+/*
+ * A buffer which is read to evict other lines from a cache level: the L1 eviction uses the first
+ * EVICT_FACTOR * L1 bytes and the L2 eviction the first EVICT_FACTOR * L2 bytes. Huge pages so that it
+ * covers every set evenly.
+ */
+struct EvictionBuffer {
+    size_t l1_size, l2_size;
+    char *start;
+
+    EvictionBuffer() :
+        l1_size{EVICT_FACTOR * cache_size(_SC_LEVEL1_DCACHE_SIZE,  32 * 1024)},
+        l2_size{EVICT_FACTOR * cache_size(_SC_LEVEL2_CACHE_SIZE, 1024 * 1024)},
+        start{static_cast<char*>(new_huge_ptr(std::max(l1_size, l2_size)))} {}
+};
+
+static const EvictionBuffer& eviction_buffer() {
+    static EvictionBuffer buffer; // leak
+    return buffer;
+}
+
+static void touch(const char *start, size_t size) {
+    for (const char *p = start, *e = start + size; p < e; p += UB_CACHE_LINE_SIZE) {
+        *(volatile const char *)p;
+    }
+}
+
+static void touch_region(void *arg) {
+    const region* r = static_cast<region*>(arg);
+    touch(static_cast<const char*>(r->start), r->size);
+}
+
+long cache_state_flushed(uint64_t iters, void *arg) {
+    const region* r = static_cast<region*>(arg);
+    for (char *p = static_cast<char*>(r->start), *e = p + r->size; p < e; p += UB_CACHE_LINE_SIZE) {
+        _mm_clflush(p);
+    }
+    _mm_mfence();
+    return 0;
+}
+
+long cache_state_l1(uint64_t iters, void *arg) {
+    // twice, since the first pass may evict early lines of a region which nearly fills L1
+    touch_region(arg);
+    touch_region(arg);
+    _mm_mfence();
+    return 0;
+}
+
+long cache_state_l2(uint64_t iters, void *arg) {
+    auto& evict = eviction_buffer();
+    touch_region(arg);
+    touch(evict.start, evict.l1_size);
+    _mm_mfence();
+    return 0;
+}
+
+long cache_state_llc(uint64_t iters, void *arg) {
+    auto& evict = eviction_buffer();
+    touch_region(arg);
+    touch(evict.start, evict.l2_size);
+    _mm_mfence();
+    return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * cache-state.hpp
+ *
+ * Putting the memory a benchmark accesses into a known cache state before each sample, so that the results
+ * don't depend on whatever ran before the benchmark (see DeltaMaker::setCacheState).
+ */
+
+#ifndef CACHE_STATE_HPP_
+#define CACHE_STATE_HPP_
+
+#include "bench-declarations.h"
+
+/** the cache state a benchmark's region is put into (untimed) before each sample */
+enum class CacheState {
+    /* don't touch the region: the state is whatever the previous sample or benchmark left behind */
+    ANY,
+    /* flush every line of the region from all cache levels */
+    FLUSHED,
+    /* load every line of the region, so it is in L1 as far as it fits */
+    L1,
+    /* load every line of the region, then evict it from L1 so it is in L2 (but not L1) as far as it fits */
+    L2,
+    /* load every line of the region, then evict it from L1 and L2, leaving it in the LLC as far as it fits */
+    LLC
+};
+
+/*
+ * The untimed per-sample functions which establish each state. They are bench2_f so they can be used as the
+ * WARM_EVERY hook of time_one, and their arg must be the region the benchmark accesses (a region*), like the
+ * arg of most memory benchmarks.
+ */
+extern "C" {
+bench2_f cache_state_flushed;
+bench2_f cache_state_l1;
+bench2_f cache_state_l2;
+bench2_f cache_state_llc;
+}
+
+#endif /* CACHE_STATE_HPP_ */
@@ -0,0 +1,208 @@
+/*
+ * call-benches-rsb.cpp
+ *
+ * Return stack buffer (RSB) depth and the cost of mispredicted returns, using call chains generated at runtime by the
+ * jit emitter.
+ *
+ * call/rsb/depth-N makes N nested calls, to N distinct functions, then returns from all of them. Every function
+ * returns through the same ret instruction, so once the chain is deeper than the RSB the returns it can't predict
+ * can't be predicted from the BTB either (as some CPUs do when the RSB underflows). Results are per call/ret pair,
+ * and the group ends with the inferred RSB depth: the last depth before the cycles per pair start to climb.
+ *
+ * The mismatched cases are a ret to a different address than its call pushed (ret-mismatch), and returns with no
+ * calls at all, which underflow the RSB (underflow-K: K returns to addresses pushed by the code).
+ */
+
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "jit.hpp"
+#include "simple-timer.hpp"
+#include "plateaus.hpp"
+
+using namespace std;
+using namespace jit;
+
+constexpr int RSB_MAX_DEPTH = 64;
+constexpr int RSB_UNDERFLOW_RETS[] = {2, 8, 32};
+/* the relative tolerance and least number of depths for the cycles per call/ret pair to count as flat */
+constexpr double RSB_PLATEAU_TOL = 0.15;
+constexpr size_t RSB_PLATEAU_LEN = 4;
+
+/* depth nested calls (see above), the last of which returns at once */
+static Emitter emit_depth(int depth) {
+    Emitter e;
+    Fixup start = e.jmp_forward(false);
+    Label shared_ret = e.here();
+    e.ret();
+    // emit the deepest function first so that every call is to a function already emitted
+    Label callee = e.here();
+    e.jmp(shared_ret);
+    for (int i = 1; i < depth; i++) {
+        Label f = e.here();
+        e.call(callee);
+        e.jmp(shared_ret);
+        callee = f;
+    }
+    e.bind(start);
+    loop(e, [=](Emitter& e) {
+        e.call(callee);
+    });
+    e.ret();
+    return e;
+}
+
+/* a call to a function which replaces its return address, so the ret goes elsewhere */
+static Emitter emit_mismatch() {
+    Emitter e;
+    Fixup call = {};
+    Label landing = {};
+    loop(e, [&](Emitter& e) {
+        call = e.call_forward();
+        // only ever reached speculatively, by the mispredicted ret
+        e.ud2();
+        landing = e.here();
+    });
+    e.ret();
+    e.bind(call);
+    e.lea(RAX, landing);
+    e.mov(ptr(RSP), RAX);
+    e.ret();
+    return e;
+}
+
+/* rets rets per iteration with no matching calls: the first rets - 1 return to a ret, the last back into the loop */
+static Emitter emit_underflow(int rets) {
+    Emitter e;
+    Fixup sled = e.lea_forward(RCX);
+    loop(e, [=](Emitter& e) {
+        Fixup cont = e.lea_forward(RAX);
+        e.push(RAX);
+        for (int i = 1; i < rets; i++) {
+            e.push(RCX);
+        }
+        e.ret();
+        e.bind(cont);
+    });
+    e.ret();
+    e.bind(sled);
+    e.ret();
+    return e;
+}
+
+/*
+ * Runs the benchmarks, then infers the RSB depth from the depth-N results: the cycles per iteration grow by about
+ * the same amount per level while every return is predicted, and by a mispredict more per level beyond the RSB.
+ */
+class RsbGroup : public BenchmarkGroup {
+    /* parallel to getBenches(): the call depth for the depth-N benchmarks, 0 for the others */
+    vector<int> depths_;
+
+public:
+    RsbGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    template <typename TIMER>
+    static shared_ptr<RsbGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<RsbGroup>(id, desc);
+        auto maker = DeltaMaker<TIMER>(group.get(), 1000);
+
+        // the code is generated when the benchmark first runs, not at startup
+        auto lazy = [](std::function<Emitter()> emit) {
+            auto call = make_shared<JitCall>();
+            return [=]{
+                if (!call->code) {
+                    call->code = emit().finish();
+                }
+                return call.get();
+            };
+        };
+
+        for (int depth = 1; depth <= RSB_MAX_DEPTH; depth++) {
+            maker.template make<jit_call>(string_format("depth-%d", depth),
+                    string_format("%d nested calls", depth), depth, lazy([=]{ return emit_depth(depth); }));
+            group->depths_.push_back(depth);
+        }
+        maker.template make<jit_call>("ret-mismatch", "ret to a different address", 1, lazy(emit_mismatch));
+        group->depths_.push_back(0);
+        for (int rets : RSB_UNDERFLOW_RETS) {
+            maker.template make<jit_call>(string_format("underflow-%d", rets),
+                    string_format("%d rets without calls", rets), rets, lazy([=]{ return emit_underflow(rets); }));
+            group->depths_.push_back(0);
+        }
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == depths_.size());
+
+        bool header = false;
+        // cycles per iteration by depth, NAN if not run
+        vector<double> totals(RSB_MAX_DEPTH + 1, NAN);
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b)) {
+                continue;
+            }
+            if (!header) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                printGroupHeader(c);
+                header = true;
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            if (depths_[i]) {
+                totals[depths_[i]] = result.getCycles() * depths_[i];
+            }
+        }
+
+        if (!header) {
+            return;
+        }
+
+        printInferred(c, totals);
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+
+    /*
+     * The cycles per call/ret pair are flat while the chain fits in the RSB and climb beyond it, as more of the
+     * returns mispredict, so the RSB depth is taken as the end of the first plateau in them, and the penalty as the
+     * extra cycles per level beyond it, over the cycles per pair on the plateau. Needs every depth to have run.
+     */
+    static void printInferred(Context& c, const vector<double>& totals) {
+        if (std::any_of(totals.begin() + 1, totals.end(), [](double t){ return std::isnan(t); })) {
+            return;
+        }
+        vector<double> per_pair;
+        for (size_t d = 1; d < totals.size(); d++) {
+            per_pair.push_back(totals[d] / d);
+        }
+        auto plateaus = find_plateaus(per_pair, RSB_PLATEAU_TOL, RSB_PLATEAU_LEN);
+        if (plateaus.empty()) {
+            c.out() << "No return stack depth inferred: the cycles per call/ret pair never level off" << endl;
+            return;
+        }
+        const Plateau& p = plateaus.front();
+        size_t depth = p.last + 1;
+        if (depth == RSB_MAX_DEPTH) {
+            c.out() << "No return stack limit up to depth " << RSB_MAX_DEPTH << endl;
+            return;
+        }
+        double penalty = (totals[RSB_MAX_DEPTH] - totals[depth]) / (RSB_MAX_DEPTH - depth) - p.level;
+        c.out() << "Inferred return stack depth: " << depth
+                << string_format(" (about %.1f cycles more per return beyond it)", penalty) << endl;
+    }
+};
+
+template <typename TIMER>
+void register_call_rsb(GroupList& list) {
+    list.push_back(RsbGroup::make<TIMER>("call/rsb", "Return stack depth and mismatched call/ret"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_call_rsb<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -27,6 +27,9 @@ bench2_f addrsp0_calls;
 bench2_f addrsp8_calls;
 }
 
+template <typename TIMER>
+void register_call_rsb(GroupList& list);
+
 
 
 
@@ -55,6 +58,8 @@ void register_call(GroupList& list) {
     default_maker.template make<pushpop_calls>    ("pushpop-call", "calls to pushpop fn",  16);
     default_maker.template make<addrsp0_calls>    ("addrsp0-call", "calls to addrsp0 fn",  16);
     default_maker.template make<addrsp8_calls>    ("addrsp8-call", "calls to addrsp8 fn",  16);
+
+    register_call_rsb<TIMER>(list);
 }
 
 #define REGISTER(CLOCK) template void register_call<CLOCK>(GroupList& list);
@@ -0,0 +1,186 @@
+/*
+ * contended.hpp
+ *
+ * Support for benchmarks where the timed main thread runs concurrently with helper threads pinned to the
+ * other allowed CPUs, e.g., to measure the cost of contention on a shared cache line.
+ */
+
+#ifndef CONTENDED_HPP_
+#define CONTENDED_HPP_
+
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <cmath>
+
+#include "benchmark.hpp"
+#include "context.hpp"
+#include "isa-support.hpp"
+#include "table.hpp"
+#include "timers.hpp"
+#include "simple-timer.hpp"
+
+/* the allowed CPUs other than the one the main thread is pinned to, in increasing order */
+static inline std::vector<int> helper_cpus(Context& c) {
+    std::vector<int> cpus;
+    for (int cpu : c.getAllowedCpus()) {
+        if (cpu != c.getPinnedCpu()) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/*
+ * Coordinates the helper threads: the helpers start calling their benchmark function when go is set and stop
+ * when stop is set, recording how many operations they did and how long it took.
+ */
+struct Contenders {
+    /* the number of benchmark loop iterations helpers do between checks of the stop flag */
+    static constexpr uint64_t HELPER_LOOPS = 100;
+
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false}, stop{false};
+
+    struct Result {
+        uint64_t ops;
+        int64_t nanos;
+    };
+
+    static void run(Contenders& s, Context& c, int cpu, bench2_f* func, uint32_t ops_per_loop, void *arg, Result& result) {
+        pinToThread(c, cpu, false);
+        s.ready++;
+        while (!s.go.load(std::memory_order_acquire))
+            ;
+        uint64_t loops = 0;
+        int64_t start = nanos();
+        while (!s.stop.load(std::memory_order_relaxed)) {
+            func(HELPER_LOOPS, arg);
+            loops += HELPER_LOOPS;
+        }
+        result = { loops * ops_per_loop, nanos() - start };
+    }
+};
+
+/*
+ * A group whose benchmarks are each run with 2, 4, 8, ... and finally all allowed CPUs executing the same
+ * benchmark function at once. Each thread gets its own argument from the benchmark's arg_for function,
+ * called with the thread index (0 for the main thread), so the threads can share a location or not.
+ *
+ * The main thread is measured by the selected timer as usual, while the helpers measure their own throughput
+ * over the whole run (using the clock calibration to convert to cycles). The per-thread and aggregate
+ * throughput for every thread count is printed, followed by a summary of the aggregate throughput.
+ */
+class ContendedGroup : public BenchmarkGroup {
+public:
+    typedef std::function<void *(size_t thread)> thread_arg_t;
+
+private:
+    struct Entry {
+        bench2_f* func;
+        uint32_t ops_per_loop;
+        thread_arg_t arg_for;
+    };
+
+    /* parallel to getBenches() */
+    std::vector<Entry> entries_;
+
+public:
+    ContendedGroup(const std::string& id, const std::string& desc) : BenchmarkGroup(id, desc) {}
+
+    /* make a benchmark for METHOD using maker and remember what the helpers need to run it */
+    template <bench2_f METHOD, typename TIMER>
+    void add(DeltaMaker<TIMER> maker, const std::string& id, const std::string& desc, uint32_t ops_per_loop,
+            thread_arg_t arg_for) {
+        assert(&maker.getGroup() == this);
+        maker.template make<METHOD>(id, desc, ops_per_loop, [=]{ return arg_for(0); });
+        entries_.push_back({METHOD, ops_per_loop, arg_for});
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        std::vector<int> helpers = helper_cpus(c);
+        std::vector<size_t> thread_counts;
+        for (size_t threads = 2; threads <= helpers.size() + 1; threads *= 2) {
+            thread_counts.push_back(threads);
+        }
+        if (!helpers.empty() && thread_counts.back() != helpers.size() + 1) {
+            thread_counts.push_back(helpers.size() + 1);
+        }
+
+        SimpleTimer timer;
+        using namespace table;
+        Table summary;
+        auto& header = summary.newRow().add("Benchmark");
+        for (size_t threads : thread_counts) {
+            header.add(string_format("%zu threads", threads));
+        }
+
+        bool first = true;
+        auto& benches = getBenches();
+        assert(benches.size() == entries_.size());
+        for (size_t b = 0; b < benches.size(); b++) {
+            if (!predicate(benches[b])) {
+                continue;
+            }
+            if (first) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                if (helpers.empty()) {
+                    c.out() << "Skipping: needs at least 2 allowed CPUs, but only 1 available" << std::endl;
+                    return;
+                }
+                first = false;
+            }
+            if (!supports(benches[b]->getFeatures())) {
+                c.out() << "Skipping " << benches[b]->getPath() << " because hardware doesn't support required features: "
+                        << container_to_string(benches[b]->getFeatures()) << std::endl;
+                continue;
+            }
+            auto& row = summary.newRow().add(benches[b]->getId());
+            for (size_t threads : thread_counts) {
+                std::vector<int> cpus(helpers.begin(), helpers.begin() + threads - 1);
+                row.add(string_format("%.3f", runOne(c, benches[b], entries_[b], cpus)));
+            }
+        }
+
+        if (first) {
+            return;
+        }
+
+        c.out() << std::endl << "Aggregate ops per cycle by thread count:" << std::endl << summary.str();
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << std::endl;
+    }
+
+private:
+    /* run one benchmark with the given helper CPUs, print the per-thread results and return the aggregate ops/cycle */
+    static double runOne(Context& c, const Benchmark& b, const Entry& entry, const std::vector<int>& cpus) {
+        Contenders state;
+        std::vector<Contenders::Result> results(cpus.size());
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < cpus.size(); i++) {
+            threads.emplace_back(Contenders::run, std::ref(state), std::ref(c), cpus[i], entry.func, entry.ops_per_loop,
+                    entry.arg_for(i + 1), std::ref(results[i]));
+        }
+        while (state.ready.load() != cpus.size())
+            ;
+        state.go = true;
+        TimingResult result = b->run(c.getTimerInfo());
+        state.stop = true;
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        double main_rate = 1 / result.getCycles(), total = main_rate;
+        double ghz = DefaultClockTimer::getGHz(), min_rate = INFINITY, max_rate = 0;
+        for (auto& r : results) {
+            double rate = r.ops / (r.nanos * ghz);
+            min_rate = std::min(min_rate, rate);
+            max_rate = std::max(max_rate, rate);
+            total += rate;
+        }
+        c.out() << string_format("%-40s %3zu threads: main %.3f ops/cycle, helpers %.3f - %.3f ops/cycle, aggregate %.3f ops/cycle",
+                b->getDescription().c_str(), cpus.size() + 1, main_rate, min_rate, max_rate, total) << std::endl;
+        return total;
+    }
+};
+
+#endif /* CONTENDED_HPP_ */
@@ -6,6 +6,7 @@
 #include "benchmark.hpp"
 #include "timers.hpp"
 #include "matchers.hpp"
+#include "numa.hpp"
 
 #include <iostream>
 
@@ -53,6 +54,14 @@ GroupList make_benches() {
     register_call<TIMER>(groupList);
     register_oneshot<TIMER>(groupList);
     register_syscall<TIMER>(groupList);
+    register_thread<TIMER>(groupList);
+    register_atomics<TIMER>(groupList);
+    register_instructions<TIMER>(groupList);
+    register_timeline<TIMER>(groupList);
+    register_branch<TIMER>(groupList);
+    register_frontend<TIMER>(groupList);
+    register_smc<TIMER>(groupList);
+    register_asm<TIMER>(groupList);
 
     return groupList;
 }
@@ -162,31 +171,37 @@ void handleTimerSpecificRun(Context& c) {
 }
 
 TimerArgs Context::getTimerArgs() {
-    return { arg_extraevents.Get() };
+    return { arg_extraevents.Get(), arg_ports };
 }
 
-/** get the first available CPU based on the affinity mask */
-int getFirstAvailableCpu() {
+/** get all the available CPUs based on the affinity mask */
+std::vector<int> getAvailableCpus() {
     cpu_set_t cpu_set;
     if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set)) {
         throw std::runtime_error("failed while getting existing cpu affinity: " + errno_to_str(errno));
     }
+    std::vector<int> cpus;
     for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
         if (CPU_ISSET(cpu, &cpu_set)) {
-            return cpu;
+            cpus.push_back(cpu);
         }
     }
-    throw std::runtime_error("not allowed to run on any CPUs - impossible?");
+    if (cpus.empty()) {
+        throw std::runtime_error("not allowed to run on any CPUs - impossible?");
+    }
+    return cpus;
 }
 
-void pinToThread(Context& c, int cpu) {
+void pinToThread(Context& c, int cpu, bool log) {
     cpu_set_t cpuset;
     CPU_ZERO(&cpuset);
     CPU_SET(cpu, &cpuset);
     if (sched_setaffinity(0, sizeof(cpuset), &cpuset)) {
-        throw std::runtime_error("failed to pin: " + errno_to_str(errno));
+        throw std::runtime_error("failed to pin to CPU " + std::to_string(cpu) + ": " + errno_to_str(errno));
+    }
+    if (log) {
+        c.log() << "Pinned to CPU " << cpu << endl;
     }
-    c.log() << "Pinned to CPU " << cpu << endl;
 }
 
 void Context::run() {
@@ -204,7 +219,24 @@ void Context::run() {
         throw SilentSuccess();
     } else {
         // pinning should happen early since some timers rely on it in their init phase
-        pinToThread(*this, arg_pincpu ? arg_pincpu.Get() : getFirstAvailableCpu());
+        allowed_cpus_ = getAvailableCpus();
+        pinned_cpu_ = arg_pincpu ? arg_pincpu.Get() : allowed_cpus_.front();
+        pinToThread(*this, pinned_cpu_);
+
+        // memory placement should also be set before anything allocates benchmark buffers
+        if (arg_mem_node) {
+            MemPolicy policy{};
+            try {
+                policy = MemPolicy::parse(arg_mem_node.Get());
+            } catch (std::logic_error&) {
+                fatal("--mem-node must be a NUMA node number or 'interleave', but was '%s'", arg_mem_node.Get().c_str());
+            }
+            set_mem_policy(policy);
+        }
+        if (arg_mem_node || numa_memory_nodes().size() > 1) {
+            out() << "NUMA placement: CPU " << pinned_cpu_ << " on node " << numa_node_of_cpu(pinned_cpu_)
+                    << ", memory on " << get_mem_policy().to_string() << endl;
+        }
 
         TimeredList& toRun = getForTimer(*this);
         timer_info_ = &toRun.getTimerInfo();
@@ -215,7 +247,10 @@ void Context::run() {
         } else {
             timer_info_->init(*this);
             predicate_t pred;
-            if (!arg_test_tag && !arg_test_name) {
+            if (arg_asm) {
+                // only the snippet, which matches no other predicate since it isn't registered until now
+                pred = [](const Benchmark& b){ return b->getPath() == ASM_SNIPPET_PATH; };
+            } else if (!arg_test_tag && !arg_test_name) {
                 // no predicates specified on the command line, use tag=* as default predicate
                 TagMatcher matcher{"default"};
                 pred = [matcher](const Benchmark& b){ return matcher(b->getTags()); };
@@ -6,6 +6,7 @@
 #define CONTEXT_HPP_
 
 #include <iostream>
+#include <vector>
 
 #include "args.hxx"
 #include "timer-info.hpp"
@@ -52,10 +53,60 @@ public:
         return arg_default_precision.Get();
     }
 
+    /* return the number of points per doubling of footprint to use for sweep benchmarks */
+    unsigned int getSweepDensity() {
+        return arg_sweep_density.Get();
+    }
+
+    /* the duration of each timeline benchmark in milliseconds */
+    unsigned int getTimelineMs() {
+        return arg_timeline_ms.Get();
+    }
+
+    /* the directory to write the full series of timeline benchmarks to as CSV, empty if none */
+    std::string getTimelineDir() {
+        return arg_timeline_dir ? arg_timeline_dir.Get() : std::string();
+    }
+
+    /* the comma separated nop lengths the frontend/size loops are made of */
+    std::string getFrontendMix() {
+        return arg_frontend_mix.Get();
+    }
+
+    /* true if an assembly snippet to benchmark was given with --asm */
+    bool hasAsm() {
+        return arg_asm;
+    }
+
+    /* the --asm snippet, with instructions separated by newlines or semicolons */
+    std::string getAsm() {
+        return arg_asm.Get();
+    }
+
+    /* the number of copies of the --asm snippet in the benchmark loop */
+    unsigned int getAsmRepeat() {
+        return arg_asm_repeat.Get();
+    }
+
+    /* the nasm binary used to assemble --asm snippets, empty to use the one built alongside uarch-bench */
+    std::string getNasmPath() {
+        return arg_nasm ? arg_nasm.Get() : std::string();
+    }
+
     std::string getTimerName() {
         return arg_timer ? arg_timer.Get() : "clock";
     }
 
+    /* return the CPU the main benchmark thread is pinned to */
+    int getPinnedCpu() {
+        return pinned_cpu_;
+    }
+
+    /* return the CPUs the process was allowed to run on before the main thread was pinned, in increasing order */
+    const std::vector<int>& getAllowedCpus() {
+        return allowed_cpus_;
+    }
+
     /* return the TimerInfo for the timer associated with the current context, if any */
     TimerInfo& getTimerInfo() {
         return *timer_info_;
@@ -73,6 +124,8 @@ public:
 private:
     std::ostream *err_, *log_, *out_;
     TimerInfo *timer_info_;
+    int pinned_cpu_;
+    std::vector<int> allowed_cpus_;
     int argc_;
     char **argv_;
     bool verbose_;
@@ -91,6 +144,24 @@ private:
     args::ValueFlag<std::string> arg_test_tag{parser, "PATTERN", "Run only the tests with a tag matching the given pattern", {"test-tag"}};
     args::Flag arg_listevents{parser, "list-events", "Display the extra available events associated with the timer", {"list-events"}};
     args::ValueFlag<std::string> arg_extraevents{parser, "extra-events", "A comma separated list of extra timer-specific events to track", {"extra-events"}};
+    args::Flag arg_ports{parser, "ports", "Count the uops dispatched to each execution port (with the perf or libpfc"
+            " timers), running each benchmark in as many passes as needed, and name the busiest port", {"ports"}};
+    args::ValueFlag<unsigned int> arg_sweep_density{parser, "POINTS", "Number of points per doubling of the footprint"
+            " for sweep benchmarks such as memory/latency-sweep (1, 2, 4 or 8)", {"sweep-density"}, 2};
+    args::ValueFlag<std::string> arg_mem_node{parser, "NODE", "Place benchmark memory on the given NUMA node, or"
+            " interleave it across all nodes with 'interleave' (default: first-touch placement)", {"mem-node"}};
+    args::ValueFlag<unsigned int> arg_timeline_ms{parser, "MS", "Duration of each timeline benchmark (e.g.,"
+            " timeline/avx) in milliseconds", {"timeline-ms"}, 10};
+    args::ValueFlag<std::string> arg_timeline_dir{parser, "DIR", "Write every sample of timeline benchmarks as CSV"
+            " to DIR, one file per benchmark", {"timeline-dir"}};
+    args::ValueFlag<std::string> arg_frontend_mix{parser, "LENGTHS", "Comma separated nop lengths (1 to 9 bytes),"
+            " used in turn to fill the frontend/size loops", {"frontend-mix"}, "4"};
+    args::ValueFlag<std::string> arg_asm{parser, "SNIPPET", "Benchmark the given assembly (NASM syntax, instructions"
+            " separated by ';') instead of the registered benchmarks, e.g., --asm 'imul rax, rax'", {"asm"}};
+    args::ValueFlag<unsigned int> arg_asm_repeat{parser, "COUNT", "Number of copies of the --asm snippet in the"
+            " benchmark loop, results are per copy", {"repeat"}, 1};
+    args::ValueFlag<std::string> arg_nasm{parser, "PATH", "The nasm used to assemble --asm snippets (default: the"
+            " nasm in nasm-2.13.03 next to the binary, otherwise nasm on the PATH)", {"nasm"}};
     args::ValueFlag<int> arg_pincpu{parser, "pinned-cpu", "All tests will be pinned this CPU to (defaults to first available CPU)", {'c', "pinned-cpu"}, 0};
 
 
@@ -103,5 +174,10 @@ private:
 };
 
 
+/*
+ * Pin the calling thread to the given CPU. Benchmarks that move threads around repeatedly (e.g., across every
+ * pair of CPUs) should pass log = false to avoid a line of output per call.
+ */
+void pinToThread(Context& c, int cpu, bool log = true);
 
 #endif /* CONTEXT_HPP_ */
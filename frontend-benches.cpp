@@ -0,0 +1,473 @@
+/*
+ * frontend-benches.cpp
+ *
+ * Capacity of the frontend: the uop cache (DSB), the loop stream detector (LSD), the legacy decoders (MITE), the
+ * instruction caches and the ITLB, using code generated at runtime by the jit emitter.
+ *
+ * frontend/size: loops whose total size (including the loop branch) doubles from FRONTEND_MIN_BYTES to
+ * FRONTEND_MAX_BYTES, filled with nops whose lengths cycle through --frontend-mix (e.g., 3,3,3,3,4 as in
+ * decode33334), with the top of the loop 64-byte aligned, or 32-byte but not 64-byte aligned. Results are cycles
+ * per iteration. Add IDQ.DSB_UOPS, IDQ.MITE_UOPS and LSD.UOPS with --extra-events (perf or libpfc timers) to also
+ * see the fraction of the uops delivered by each path, so the point at which a loop outgrows the LSD or the DSB
+ * shows up directly.
+ *
+ * frontend/footprint: code footprints from FOOTPRINT_MIN_BYTES to FOOTPRINT_MAX_BYTES, made of 64-byte blocks of
+ * nops, to show the cost of running code which outgrows the L1I, the L2 and the reach of the ITLB and STLB. The
+ * layouts are straight (the blocks run in address order, falling through from one to the next), chained (each
+ * block ends in a jmp to the next in a random order, which defeats the next-line prefetcher) and pages (one block
+ * per 4 KiB page of the footprint, at a different offset in each page so they don't share L1I sets, chained in a
+ * random order, which stresses the ITLB with little code). Each layout is run with the code in 4 KiB pages and in
+ * 2 MiB (transparent huge) pages, and the 2 MiB results are flagged when the kernel didn't back all of the code with
+ * huge pages (see AnonHugePages in /proc/self/smaps). Results are cycles per block.
+ */
+
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+#include "benchmark.hpp"
+#include "context.hpp"
+#include "util.hpp"
+#include "jit.hpp"
+#include "table.hpp"
+#include "simple-timer.hpp"
+
+using namespace std;
+using namespace jit;
+
+constexpr size_t FRONTEND_MIN_BYTES = 16;
+constexpr size_t FRONTEND_MAX_BYTES = 64 * 1024;
+/* the alignments of the top of the loop: 64 is 64-byte aligned, 32 is 32-byte aligned but not 64-byte aligned */
+constexpr size_t FRONTEND_ALIGNS[] = {64, 32};
+/* the total bytes of loop body run per sample, spread over as many iterations as needed */
+constexpr size_t FRONTEND_TOTAL_BYTES = 1 << 20;
+/* the longest nop in a mix, i.e., the longest nop jit::Emitter::nop emits as a single instruction */
+constexpr unsigned FRONTEND_MAX_LENGTH = 9;
+/* the fraction of the uops a path must deliver to count as the one the loop runs from */
+constexpr double FRONTEND_MOSTLY = 0.5;
+
+constexpr size_t FOOTPRINT_MIN_BYTES = 4 * 1024;
+constexpr size_t FOOTPRINT_MAX_BYTES = 16 * 1024 * 1024;
+constexpr size_t FOOTPRINT_BLOCK = 64;
+constexpr size_t FOOTPRINT_PAGE = 4096;
+/* the total blocks run per sample, spread over as many iterations as needed */
+constexpr size_t FOOTPRINT_TOTAL_BLOCKS = 1 << 16;
+
+/* the paths uops are delivered by, and the (truncated) headers of the events counting their uops */
+static const struct {
+    const char *name;
+    const char *header;
+} FRONTEND_PATHS[] = {
+    {"DSB",  "IDQ.DS"},
+    {"MITE", "IDQ.MI"},
+    {"LSD",  "LSD.UO"},
+};
+
+/*
+ * A loop of exactly size bytes (including the dec/jnz) at the given alignment, filled with nops of the lengths in
+ * mix, in turn. The last nop is shortened as needed to fit.
+ */
+static Emitter emit_size(size_t size, size_t align, const vector<unsigned>& mix) {
+    Emitter e;
+    // pad so the loop starts at align modulo 64 (the code itself starts on a page boundary)
+    e.nop(align % 64);
+    size_t start = e.size();
+    size_t branch = size <= 128 ? 5 : 9;  // dec rdi (3 bytes) and a jnz with a rel8 or rel32 displacement
+    loop(e, [&](Emitter& e) {
+        size_t body = size - branch;
+        for (size_t i = 0; e.size() - start < body; i++) {
+            e.nop(std::min((size_t)mix[i % mix.size()], body - (e.size() - start)));
+        }
+    });
+    assert(e.size() - start == size);
+    e.ret();
+    return e;
+}
+
+enum FootprintLayout { STRAIGHT, CHAINED, PAGES };
+
+static const char *FOOTPRINT_LAYOUT_NAMES[] = {"straight", "chained", "pages"};
+
+/* the offset of the i-th block (in address order) from the start of the blocks */
+static size_t block_offset(FootprintLayout layout, size_t i) {
+    return layout == PAGES ? i * FOOTPRINT_PAGE + i % (FOOTPRINT_PAGE / FOOTPRINT_BLOCK) * FOOTPRINT_BLOCK
+                           : i * FOOTPRINT_BLOCK;
+}
+
+/* fill len bytes with 4-byte nops, and a shorter one at the end if needed */
+static void fill_nops(Emitter& e, size_t len) {
+    for (; len >= 4; len -= 4) {
+        e.nop(4);
+    }
+    e.nop(len);
+}
+
+/*
+ * One iteration runs the blocks of a footprint of the given size in the given layout (see above). The first page
+ * holds the loop itself: a jmp to the first block at the top, and the dec/jnz which the last block jumps back to.
+ */
+static Emitter emit_footprint(FootprintLayout layout, size_t bytes) {
+    size_t count = bytes / (layout == PAGES ? FOOTPRINT_PAGE : FOOTPRINT_BLOCK);
+    // the blocks in the order they run
+    vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    if (layout != STRAIGHT) {
+        std::shuffle(order.begin(), order.end(), std::mt19937_64{123});
+    }
+    // the offset of each block, and of the block (or the loop tail) after it in the run order
+    Label tail{FOOTPRINT_BLOCK};
+    vector<Label> blocks(count), next(count);
+    for (size_t i = 0; i < count; i++) {
+        blocks[i] = Label{FOOTPRINT_PAGE + block_offset(layout, i)};
+    }
+    for (size_t k = 0; k < count; k++) {
+        next[order[k]] = k + 1 < count ? blocks[order[k + 1]] : tail;
+    }
+
+    Emitter e;
+    Label top = e.here();
+    e.jmp(blocks[order[0]]);
+    e.nop(tail.offset - e.size());
+    e.dec(RDI).jnz(top);
+    e.ret();
+    for (size_t i = 0; i < count; i++) {
+        // the padding up to each block is never run
+        e.nop(blocks[i].offset - e.size());
+        if (layout == STRAIGHT && i + 1 < count) {
+            fill_nops(e, FOOTPRINT_BLOCK);
+        } else {
+            fill_nops(e, FOOTPRINT_BLOCK - 5);
+            e.jmp(next[i]);
+        }
+        assert(e.size() <= blocks[i].offset + FOOTPRINT_BLOCK);
+    }
+    return e;
+}
+
+/* the index of the metric whose header starts with prefix, treating : (as in libpfc event names) as ., or size() */
+static size_t find_metric(const vector<string>& names, const string& prefix) {
+    for (size_t i = 0; i < names.size(); i++) {
+        string n = names[i];
+        std::replace(n.begin(), n.end(), ':', '.');
+        if (n.compare(0, prefix.size(), prefix) == 0) {
+            return i;
+        }
+    }
+    return names.size();
+}
+
+/*
+ * Runs the benchmarks for each size and alignment, generating the loops with the --frontend-mix of the run, then
+ * prints the cycles per iteration, and the fraction of uops from each path if counted, with a row per size.
+ */
+class FrontendGroup : public BenchmarkGroup {
+    struct Point {
+        size_t size;
+        size_t align;
+    };
+
+    /* parallel to getBenches() */
+    vector<Point> points_;
+    /* the nop lengths the loops are made of, set from the context before running */
+    vector<unsigned> mix_;
+
+public:
+    FrontendGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    template <typename TIMER>
+    static shared_ptr<FrontendGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<FrontendGroup>(id, desc);
+        FrontendGroup* g = group.get();
+        auto maker = DeltaMaker<TIMER>(g);
+        for (size_t align : FRONTEND_ALIGNS) {
+            for (size_t size = FRONTEND_MIN_BYTES; size <= FRONTEND_MAX_BYTES; size *= 2) {
+                // the code is generated when the benchmark first runs, once the mix is known
+                auto call = make_shared<JitCall>();
+                maker.setLoopCount(std::max(FRONTEND_TOTAL_BYTES / size, (size_t)16)).template make<jit_call>(
+                        string_format("bytes-%zu-align-%zu", size, align),
+                        string_format("%zu byte loop, %zu-byte aligned", size, align),
+                        1,
+                        [=]{
+                            if (!call->code) {
+                                call->code = emit_size(size, align, g->mix_).finish();
+                            }
+                            return call.get();
+                        });
+                group->points_.push_back({size, align});
+            }
+        }
+        return group;
+    }
+
+    /* parse a comma separated list of nop lengths, such as 3,3,3,3,4 */
+    static vector<unsigned> parseMix(Context& c, const string& mix) {
+        vector<unsigned> ret;
+        for (auto& s : split_on_any(mix, ",")) {
+            char *end;
+            unsigned long len = strtoul(s.c_str(), &end, 10);
+            if (s.empty() || *end || len < 1 || len > FRONTEND_MAX_LENGTH) {
+                c.fatal("bad --frontend-mix '%s': expected a list of lengths from 1 to %u", mix.c_str(),
+                        FRONTEND_MAX_LENGTH);
+            }
+            ret.push_back(len);
+        }
+        return ret;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == points_.size());
+
+        auto& names = c.getTimerInfo().getMetricNames();
+        vector<size_t> paths;
+        for (auto& path : FRONTEND_PATHS) {
+            paths.push_back(find_metric(names, path.header));
+        }
+
+        bool header = false;
+        vector<double> cycles(points_.size(), NAN);
+        // the uops from each path, per point
+        vector<vector<double>> uops(paths.size(), vector<double>(points_.size(), NAN));
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b)) {
+                continue;
+            }
+            if (!header) {
+                mix_ = parseMix(c, c.getFrontendMix());
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                c.out() << "Nop lengths: " << c.getFrontendMix() << std::endl;
+                printGroupHeader(c);
+                header = true;
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            cycles[i] = result.getCycles();
+            for (size_t p = 0; p < paths.size(); p++) {
+                if (paths[p] < result.getResults().size()) {
+                    uops[p][i] = result.getResults()[paths[p]];
+                }
+            }
+        }
+
+        if (!header) {
+            return;
+        }
+
+        printCycles(c, cycles);
+        if (std::any_of(paths.begin(), paths.end(), [&](size_t m){ return m < names.size(); })) {
+            printFractions(c, paths, uops);
+        }
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+
+    /* the index of the point for the given size and alignment */
+    size_t find(size_t size, size_t align) {
+        for (size_t i = 0; i < points_.size(); i++) {
+            if (points_[i].size == size && points_[i].align == align) {
+                return i;
+            }
+        }
+        assert(false);
+        return 0;
+    }
+
+    void printCycles(Context& c, const vector<double>& cycles) {
+        using namespace table;
+        Table t;
+        auto& header = t.newRow().add("Bytes");
+        for (size_t a = 0; a < std::extent<decltype(FRONTEND_ALIGNS)>::value; a++) {
+            header.add(string_format("%zuB aligned", FRONTEND_ALIGNS[a]));
+            t.colInfo(a + 1).justify = ColInfo::RIGHT;
+        }
+        for (size_t size = FRONTEND_MIN_BYTES; size <= FRONTEND_MAX_BYTES; size *= 2) {
+            auto& row = t.newRow().add(size);
+            for (size_t align : FRONTEND_ALIGNS) {
+                double v = cycles[find(size, align)];
+                row.add(std::isnan(v) ? string("-") : string_format("%.2f", v));
+            }
+        }
+        c.out() << endl << "Cycles per iteration:" << endl << t.str();
+    }
+
+    /*
+     * Print the fraction of the uops counted by the path events which came from each path, followed by the largest
+     * loop which ran mostly from each path, for each alignment. Paths without an event are left out.
+     */
+    void printFractions(Context& c, const vector<size_t>& paths, const vector<vector<double>>& uops) {
+        using namespace table;
+        auto& names = c.getTimerInfo().getMetricNames();
+        Table t;
+        auto& header = t.newRow().add("Bytes");
+        size_t col = 1;
+        for (size_t align : FRONTEND_ALIGNS) {
+            for (size_t p = 0; p < paths.size(); p++) {
+                if (paths[p] < names.size()) {
+                    header.add(string_format("%s %zuB", FRONTEND_PATHS[p].name, align));
+                    t.colInfo(col++).justify = ColInfo::RIGHT;
+                }
+            }
+        }
+
+        // per alignment and path, the largest size mostly delivered by the path, 0 if none
+        vector<vector<size_t>> largest(std::extent<decltype(FRONTEND_ALIGNS)>::value, vector<size_t>(paths.size()));
+        for (size_t size = FRONTEND_MIN_BYTES; size <= FRONTEND_MAX_BYTES; size *= 2) {
+            auto& row = t.newRow().add(size);
+            for (size_t a = 0; a < largest.size(); a++) {
+                size_t i = find(size, FRONTEND_ALIGNS[a]);
+                double total = 0;
+                for (size_t p = 0; p < paths.size(); p++) {
+                    if (paths[p] < names.size()) {
+                        total += uops[p][i];
+                    }
+                }
+                for (size_t p = 0; p < paths.size(); p++) {
+                    if (paths[p] < names.size()) {
+                        double f = uops[p][i] / total;
+                        row.add(std::isnan(f) ? string("-") : string_format("%.0f%%", f * 100));
+                        if (f >= FRONTEND_MOSTLY) {
+                            largest[a][p] = size;
+                        }
+                    }
+                }
+            }
+        }
+        c.out() << endl << "Fraction of uops by path:" << endl << t.str();
+
+        for (size_t a = 0; a < largest.size(); a++) {
+            for (size_t p = 0; p < paths.size(); p++) {
+                if (paths[p] < names.size()) {
+                    c.out() << "Largest " << FRONTEND_ALIGNS[a] << "B aligned loop mostly from the "
+                            << FRONTEND_PATHS[p].name << ": "
+                            << (largest[a][p] ? std::to_string(largest[a][p]) + " bytes" : string("none")) << endl;
+                }
+            }
+        }
+    }
+};
+
+/*
+ * Runs the benchmarks for each footprint, layout and page size, then prints the cycles per block with a row per
+ * footprint. The code for each benchmark is generated when it runs and replaces the previous one, so at most one
+ * footprint is mapped at a time.
+ */
+class FootprintGroup : public BenchmarkGroup {
+    struct Point {
+        size_t bytes;
+        string column;
+        bool huge;
+    };
+
+    /* parallel to getBenches() */
+    vector<Point> points_;
+    JitCall call_;
+    /* whether the last code generated for huge pages was entirely backed by them */
+    bool huge_backed_ = false;
+
+public:
+    FootprintGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    template <typename TIMER>
+    static shared_ptr<FootprintGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<FootprintGroup>(id, desc);
+        FootprintGroup* g = group.get();
+        auto maker = DeltaMaker<TIMER>(g);
+        for (bool huge : {false, true}) {
+            for (FootprintLayout layout : {STRAIGHT, CHAINED, PAGES}) {
+                const char *name = FOOTPRINT_LAYOUT_NAMES[layout], *pages = huge ? "2M" : "4K";
+                for (size_t bytes = FOOTPRINT_MIN_BYTES; bytes <= FOOTPRINT_MAX_BYTES; bytes *= 2) {
+                    size_t blocks = bytes / (layout == PAGES ? FOOTPRINT_PAGE : FOOTPRINT_BLOCK);
+                    maker.setLoopCount(std::max(FOOTPRINT_TOTAL_BLOCKS / blocks, (size_t)1)).template make<jit_call>(
+                            string_format("%s-%zuk-%s-pages", name, bytes / 1024, pages),
+                            string_format("%zu KiB %s, %s pages", bytes / 1024, name, pages),
+                            blocks,
+                            [=]{
+                                auto& code = g->call_.code;
+                                code = emit_footprint(layout, bytes).finish(huge);
+                                g->huge_backed_ = huge && anon_huge_bytes(code->at(Label{0})) >= code->size();
+                                return &g->call_;
+                            });
+                    group->points_.push_back({bytes, string(name) + " " + pages, huge});
+                }
+            }
+        }
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == points_.size());
+
+        bool header = false;
+        vector<double> cycles(points_.size(), NAN);
+        // for the huge page points, whether the code was entirely backed by huge pages
+        vector<bool> backed(points_.size(), true);
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b)) {
+                continue;
+            }
+            if (!header) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                printGroupHeader(c);
+                header = true;
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            cycles[i] = result.getCycles();
+            backed[i] = !points_[i].huge || huge_backed_;
+        }
+        call_.code.reset();
+
+        if (!header) {
+            return;
+        }
+
+        using namespace table;
+        vector<string> columns;
+        for (auto& p : points_) {
+            if (std::find(columns.begin(), columns.end(), p.column) == columns.end()) {
+                columns.push_back(p.column);
+            }
+        }
+        Table t;
+        auto& row = t.newRow().add("KiB");
+        for (size_t i = 0; i < columns.size(); i++) {
+            row.add(columns[i]);
+            t.colInfo(i + 1).justify = ColInfo::RIGHT;
+        }
+        for (size_t bytes = FOOTPRINT_MIN_BYTES; bytes <= FOOTPRINT_MAX_BYTES; bytes *= 2) {
+            auto& row = t.newRow().add(bytes / 1024);
+            for (auto& column : columns) {
+                double v = NAN;
+                bool b = true;
+                for (size_t i = 0; i < points_.size(); i++) {
+                    if (points_[i].bytes == bytes && points_[i].column == column) {
+                        v = cycles[i];
+                        b = backed[i];
+                    }
+                }
+                row.add(std::isnan(v) ? string("-") : string_format("%.2f", v) + (b ? " " : "*"));
+            }
+        }
+        c.out() << endl << "Cycles per block:" << endl << t.str();
+        if (std::find(backed.begin(), backed.end(), false) != backed.end()) {
+            c.out() << "* not all of the code was in huge pages (transparent huge pages: " << thp_mode() << ")" << endl;
+        }
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+};
+
+template <typename TIMER>
+void register_frontend(GroupList& list) {
+    list.push_back(FrontendGroup::make<TIMER>("frontend/size", "Loop size sweep over the DSB, LSD and MITE"));
+    list.push_back(FootprintGroup::make<TIMER>("frontend/footprint", "Code footprint sweep over the L1I, L2 and ITLB"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_frontend<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
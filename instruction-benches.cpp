@@ -0,0 +1,183 @@
+/*
+ * instruction-benches.cpp
+ *
+ * The instruction table: latency and throughput of each instruction form listed in instructions.inc, in register
+ * and memory operand variants, printed as one uops.info-style table for the current CPU. The benchmarks themselves
+ * are generated from the same list by the NASM macros in x86_instructions.asm.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "table.hpp"
+#include "simple-timer.hpp"
+#include "isa-support.hpp"
+
+#define DECLARE_INSN(id, mnemonic, shape, type, feature) \
+        bench2_f insn_ ## id ## _lat;                    \
+        bench2_f insn_ ## id ## _tput;                   \
+        bench2_f insn_ ## id ## _mem;
+
+extern "C" {
+#define INSN DECLARE_INSN
+#include "instructions.inc"
+#undef INSN
+}
+
+using namespace std;
+
+/* instructions per iteration in every generated benchmark */
+constexpr int INSN_OPS = 32;
+
+/* the size of the (zeroed) buffer the memory variants access, at least a line per instruction */
+constexpr size_t INSN_BUFFER_SIZE = 4096;
+static_assert(INSN_BUFFER_SIZE >= INSN_OPS * UB_CACHE_LINE_SIZE, "INSN_BUFFER_SIZE too small");
+
+/* the feature list for each ISA name which may appear in instructions.inc, BASE being baseline x86-64 */
+namespace insn_isa {
+const vector<x86Feature> BASE{};
+#define ISA_FEATURE(f) const vector<x86Feature> f{::f};
+FEATURES_X(ISA_FEATURE)
+LOCAL_FEATURES_X(ISA_FEATURE)
+}
+
+/* one row of instructions.inc */
+struct InsnForm {
+    string id, mnemonic, shape, type, isa;
+
+    /* the operand names uops.info uses, e.g., "r64" or "m128" */
+    string reg() const {
+        string r = type;
+        std::transform(r.begin(), r.end(), r.begin(), ::tolower);
+        return r;
+    }
+
+    string mem() const {
+        return type == "R64" ? "m64" : type == "R32" ? "m32" : type == "XMM" ? "m128" : type == "YMM" ? "m256" : "m512";
+    }
+
+    /* the form as uops.info writes it, e.g., "add r64, r64", or with the memory operand "add r64, m64" */
+    string str(bool memory) const {
+        string r = reg(), m = memory ? mem() : r;
+        if (shape == "R") {
+            return mnemonic + " " + m;
+        } else if (shape == "RI") {
+            return mnemonic + " " + m + ", imm8";
+        } else if (shape == "RR") {
+            return mnemonic + " " + r + ", " + m;
+        } else {
+            return mnemonic + " " + r + ", " + r + ", " + m;
+        }
+    }
+};
+
+/*
+ * Runs the latency, throughput and memory operand benchmark of every form, then prints the table with one row for
+ * the register form and one for the memory form of each instruction.
+ */
+class InstructionGroup : public BenchmarkGroup {
+    enum Variant { LAT, TPUT, MEM, VARIANT_COUNT };
+
+    struct Entry {
+        size_t form;
+        Variant variant;
+    };
+
+    /* parallel to getBenches() */
+    vector<Entry> entries_;
+    vector<InsnForm> forms_;
+
+public:
+    InstructionGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    static void *zeroed_buffer() {
+        static void *buffer = aligned_ptr(UB_CACHE_LINE_SIZE, INSN_BUFFER_SIZE, false);
+        // the read-modify-write variants leave non-zero values behind, which the FP forms would see as denormals
+        std::memset(buffer, 0, INSN_BUFFER_SIZE);
+        return buffer;
+    }
+
+    template <typename TIMER>
+    static shared_ptr<InstructionGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<InstructionGroup>(id, desc);
+        InstructionGroup* g = group.get();
+        auto maker = DeltaMaker<TIMER>(g, 1000);
+#define MAKE_INSN(fid, mnemonic, shape, type, feature)                                                          \
+        {                                                                                                       \
+            InsnForm form{#fid, #mnemonic, #shape, #type, #feature};                                            \
+            std::replace(form.id.begin(), form.id.end(), '_', '-');                                             \
+            auto fmaker = maker.setFeatures(insn_isa::feature);                                                 \
+            fmaker.template make<insn_ ## fid ## _lat>(form.id + "-lat", form.str(false) + " latency", INSN_OPS); \
+            fmaker.template make<insn_ ## fid ## _tput>(form.id + "-tput", form.str(false) + " throughput", INSN_OPS); \
+            fmaker.template make<insn_ ## fid ## _mem>(form.id + "-mem", form.str(true) + " throughput", INSN_OPS, \
+                    zeroed_buffer);                                                                             \
+            for (Variant v : {LAT, TPUT, MEM}) {                                                                \
+                g->entries_.push_back({g->forms_.size(), v});                                                   \
+            }                                                                                                   \
+            g->forms_.push_back(form);                                                                          \
+        }
+#define INSN MAKE_INSN
+#include "instructions.inc"
+#undef INSN
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == entries_.size());
+
+        // cycles[form][variant], NAN if not run
+        vector<vector<double>> cycles(forms_.size(), vector<double>(VARIANT_COUNT, NAN));
+
+        bool header = false;
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b) || !supports(b->getFeatures())) {
+                continue;
+            }
+            if (!header) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                printGroupHeader(c);
+                header = true;
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            cycles[entries_[i].form][entries_[i].variant] = result.getCycles();
+        }
+
+        if (!header) {
+            return;
+        }
+
+        using namespace table;
+        auto cell = [](double v) { return std::isnan(v) ? string("-") : string_format("%.2f", v); };
+        Table t;
+        t.newRow().add("Instruction").add("ISA").add("Latency").add("TP");
+        for (size_t f = 0; f < forms_.size(); f++) {
+            auto& form = forms_[f];
+            auto& cyc = cycles[f];
+            if (std::isnan(cyc[LAT]) && std::isnan(cyc[TPUT]) && std::isnan(cyc[MEM])) {
+                continue;
+            }
+            t.newRow().add(form.str(false)).add(form.isa).add(cell(cyc[LAT])).add(cell(cyc[TPUT]));
+            t.newRow().add(form.str(true)).add(form.isa).add("-").add(cell(cyc[MEM]));
+        }
+        c.out() << endl << "Instruction table for " << cpu_brand() << endl
+                << "Latency in cycles through the destination register, TP in cycles per instruction (reciprocal throughput):"
+                << endl << t.str();
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+};
+
+template <typename TIMER>
+void register_instructions(GroupList& list) {
+    list.push_back(InstructionGroup::make<TIMER>("instructions/table", "Instruction latency and throughput table"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_instructions<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
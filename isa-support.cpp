@@ -6,20 +6,41 @@
 #include "cpu/cpu.h"
 
 #include <assert.h>
+#include <cpuid.h>
+
+enum CpuidReg { EAX, EBX, ECX, EDX };
+
+/* check a single feature bit in the given cpuid leaf and subleaf */
+static bool cpuid_bit(unsigned leaf, unsigned subleaf, CpuidReg reg, unsigned bit) {
+    if (__get_cpuid_max(0, nullptr) < leaf) {
+        return false;
+    }
+    unsigned regs[4];
+    __cpuid_count(leaf, subleaf, regs[EAX], regs[EBX], regs[ECX], regs[EDX]);
+    return (regs[reg] >> bit) & 1;
+}
+
+static bool check_FSRM() {
+    return cpuid_bit(7, 0, EDX, 4);
+}
 
 struct Entry {
     x86Feature feature;
     PSnipCPUFeature psnip_feature;
     const char *name;
+    /* the check for features in LOCAL_FEATURES_X, null for those checked by portable-snippets */
+    bool (*local_check)();
     bool supported() const {
-        return psnip_cpu_feature_check(psnip_feature);
+        return local_check ? local_check() : psnip_cpu_feature_check(psnip_feature);
     }
 };
 
-#define MAKE_ENTRY(x) Entry{x, PSNIP_CPU_FEATURE_X86_ ## x, #x},
+#define MAKE_ENTRY(x) Entry{x, PSNIP_CPU_FEATURE_X86_ ## x, #x, nullptr},
+#define MAKE_LOCAL_ENTRY(x) Entry{x, PSnipCPUFeature(), #x, check_ ## x},
 
 const Entry FEATURES_ARRAY[] = {
     FEATURES_X(MAKE_ENTRY)
+    LOCAL_FEATURES_X(MAKE_LOCAL_ENTRY)
 };
 
 const size_t FEATURES_COUNT = sizeof(FEATURES_ARRAY)/sizeof(FEATURES_ARRAY[0]);
@@ -57,6 +78,20 @@ std::string support_string() {
     return result;
 }
 
+std::string cpu_brand() {
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000004) {
+        return "unknown";
+    }
+    unsigned regs[12];
+    for (unsigned i = 0; i < 3; i++) {
+        __cpuid(0x80000002 + i, regs[i * 4 + EAX], regs[i * 4 + EBX], regs[i * 4 + ECX], regs[i * 4 + EDX]);
+    }
+    std::string brand(reinterpret_cast<const char *>(regs), sizeof(regs));
+    brand = brand.substr(0, brand.find('\0'));
+    size_t first = brand.find_first_not_of(' ');
+    return first == std::string::npos ? "unknown" : brand.substr(first);
+}
+
 std::ostream& operator<<(std::ostream& os, const x86Feature& f) {
     os << to_string(f);
     return os;
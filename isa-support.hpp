@@ -55,14 +55,23 @@
           f(AVX512BW  ) \
           f(AVX512VL  )
 
+/*
+ * Features portable-snippets doesn't know about, which we check for directly with cpuid.
+ *
+ * FSRM - fast short rep movsb (CPUID.(EAX=7,ECX=0):EDX[4])
+ */
+#define LOCAL_FEATURES_X(f) \
+          f(FSRM      )
+
 #define COMMA(x) x,
 
 /**
  * Features a benchmark may require from an x86 CPU.
  */
 enum x86Feature {
-    // the list is the same as the arguments in the FEATURES_X macro above
+    // the list is the same as the arguments in the FEATURES_X and LOCAL_FEATURES_X macros above
     FEATURES_X(COMMA)
+    LOCAL_FEATURES_X(COMMA)
 };
 
 /** does the current CPU support all of the given features */
@@ -73,6 +82,9 @@ std::string to_string(x86Feature);
 /** return a space-delimited string of all the features in x86Features the current CPU supports */
 std::string support_string();
 
+/** the processor brand string from cpuid, e.g., "Intel(R) Core(TM) i7-6700HQ CPU @ 2.60GHz" */
+std::string cpu_brand();
+
 std::ostream& operator<<(std::ostream& os, const x86Feature& f);
 
 
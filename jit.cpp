@@ -0,0 +1,520 @@
+/*
+ * jit.cpp
+ */
+
+#include "jit.hpp"
+#include "util.hpp"
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace jit {
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static bool fits8(int64_t v) {
+    return v >= INT8_MIN && v <= INT8_MAX;
+}
+
+Code::~Code() {
+    munmap(base_, size_);
+    if (alias_) {
+        munmap(alias_, size_);
+    }
+}
+
+void Emitter::emit32(uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        emit(v >> (i * 8));
+    }
+}
+
+void Emitter::rex(bool w, int reg, int index, int base, bool force) {
+    uint8_t r = 0x40 | (w << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+    if (r != 0x40 || force) {
+        emit(r);
+    }
+}
+
+/* the 2-byte form when possible (as NASM does), otherwise the 3-byte form, always in the 0F map */
+void Emitter::vex(int reg, int vvvv, int base, bool l, int pp, bool w) {
+    uint8_t r = (~reg >> 3) & 1, b = (~base >> 3) & 1, v = ~vvvv & 0xF;
+    if (b && !w) {
+        emit(0xC5);
+        emit((r << 7) | (v << 3) | (l << 2) | pp);
+    } else {
+        emit(0xC4);
+        emit((r << 7) | (1 << 6) | (b << 5) | 0x01);
+        emit((w << 7) | (v << 3) | (l << 2) | pp);
+    }
+}
+
+void Emitter::modrm_reg(int reg, int rm) {
+    emit(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+void Emitter::modrm_mem(int reg, Mem m, int disp_scale) {
+    int base = m.base & 7;
+    // rbp and r13 have no disp-less form, rsp and r12 need a SIB byte
+    bool disp8 = m.disp % disp_scale == 0 && fits8(m.disp / disp_scale);
+    int mod = (m.disp == 0 && base != 5) ? 0 : disp8 ? 1 : 2;
+    emit((mod << 6) | ((reg & 7) << 3) | base);
+    if (base == 4) {
+        emit(0x24);
+    }
+    if (mod == 1) {
+        emit(m.disp / disp_scale);
+    } else if (mod == 2) {
+        emit32(m.disp);
+    }
+}
+
+/* the EVEX prefix for a 512-bit instruction in the 0F map with no vvvv operand and no masking */
+void Emitter::evex512(int reg, int base, int pp, bool w) {
+    emit(0x62);
+    emit((((~reg >> 3) & 1) << 7) | (1 << 6) | (((~base >> 3) & 1) << 5) | (((~reg >> 4) & 1) << 4) | 1);
+    emit((w << 7) | (0xF << 3) | (1 << 2) | pp);
+    emit(0x48);
+}
+
+/* the group 1 ALU ops with an immediate: ext is the ModRM.reg opcode extension (0 add, 5 sub, ...) */
+void Emitter::alu_imm(int ext, Reg r, int32_t imm) {
+    rex(true, 0, 0, r);
+    if (fits8(imm)) {
+        emit(0x83);
+        modrm_reg(ext, r);
+        emit(imm);
+    } else if (r == RAX) {
+        emit((ext << 3) | 0x05);
+        emit32(imm);
+    } else {
+        emit(0x81);
+        modrm_reg(ext, r);
+        emit32(imm);
+    }
+}
+
+void Emitter::jcc(uint8_t cc, Label target) {
+    assert(target.offset <= code_.size());
+    int64_t rel = (int64_t)target.offset - (int64_t)(code_.size() + 2);
+    if (fits8(rel)) {
+        emit(0x70 | cc);
+        emit(rel);
+    } else {
+        emit(0x0F);
+        emit(0x80 | cc);
+        emit32(target.offset - (code_.size() + 4));
+    }
+}
+
+Fixup Emitter::jcc_forward(uint8_t cc, bool short_jump) {
+    if (short_jump) {
+        emit(0x70 | cc);
+        emit(0);
+        return Fixup{code_.size() - 1, true};
+    }
+    emit(0x0F);
+    emit(0x80 | cc);
+    emit32(0);
+    return Fixup{code_.size() - 4, false};
+}
+
+Fixup Emitter::jmp_forward(bool short_jump) {
+    emit(short_jump ? 0xEB : 0xE9);
+    if (short_jump) {
+        emit(0);
+        return Fixup{code_.size() - 1, true};
+    }
+    emit32(0);
+    return Fixup{code_.size() - 4, false};
+}
+
+Emitter& Emitter::jmp(Label target) {
+    int64_t rel = (int64_t)target.offset - (int64_t)(code_.size() + 2);
+    if (fits8(rel)) {
+        emit(0xEB);
+        emit(rel);
+    } else {
+        emit(0xE9);
+        emit32(target.offset - (code_.size() + 4));
+    }
+    return *this;
+}
+
+Emitter& Emitter::jmp(Reg target) {
+    rex(false, 0, 0, target);
+    emit(0xFF);
+    modrm_reg(4, target);
+    return *this;
+}
+
+Emitter& Emitter::jmp(Mem target) {
+    rex(false, 0, 0, target.base);
+    emit(0xFF);
+    modrm_mem(4, target);
+    return *this;
+}
+
+Emitter& Emitter::call(Mem target) {
+    rex(false, 0, 0, target.base);
+    emit(0xFF);
+    modrm_mem(2, target);
+    return *this;
+}
+
+Emitter& Emitter::call(Label target) {
+    assert(target.offset <= code_.size());
+    emit(0xE8);
+    emit32(target.offset - (code_.size() + 4));
+    return *this;
+}
+
+Fixup Emitter::call_forward() {
+    emit(0xE8);
+    emit32(0);
+    return Fixup{code_.size() - 4, false};
+}
+
+Emitter& Emitter::bind(Fixup jump) {
+    int64_t rel = (int64_t)code_.size() - (int64_t)(jump.offset + (jump.short_jump ? 1 : 4));
+    if (jump.short_jump) {
+        if (!fits8(rel)) {
+            throw std::logic_error("short forward jump out of range: " + std::to_string(rel));
+        }
+        code_[jump.offset] = rel;
+    } else {
+        for (int i = 0; i < 4; i++) {
+            code_[jump.offset + i] = (uint32_t)rel >> (i * 8);
+        }
+    }
+    return *this;
+}
+
+Emitter& Emitter::bytes(std::initializer_list<uint8_t> raw) {
+    code_.insert(code_.end(), raw);
+    return *this;
+}
+
+Emitter& Emitter::bytes(const std::vector<uint8_t>& raw) {
+    code_.insert(code_.end(), raw.begin(), raw.end());
+    return *this;
+}
+
+Emitter& Emitter::nop(size_t len) {
+    static const std::vector<uint8_t> nops[] = {
+        {},
+        {0x90},
+        {0x66, 0x90},
+        {0x0F, 0x1F, 0x00},
+        {0x0F, 0x1F, 0x40, 0x00},
+        {0x0F, 0x1F, 0x44, 0x00, 0x00},
+        {0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00},
+        {0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00},
+        {0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+        {0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+    };
+    const size_t max = sizeof(nops) / sizeof(nops[0]) - 1;
+    while (len > 0) {
+        size_t n = std::min(len, max);
+        code_.insert(code_.end(), nops[n].begin(), nops[n].end());
+        len -= n;
+    }
+    return *this;
+}
+
+Emitter& Emitter::mov(Reg dst, Reg src) {
+    rex(true, src, 0, dst);
+    emit(0x89);
+    modrm_reg(src, dst);
+    return *this;
+}
+
+Emitter& Emitter::mov(Reg dst, Mem src) {
+    rex(true, dst, 0, src.base);
+    emit(0x8B);
+    modrm_mem(dst, src);
+    return *this;
+}
+
+Emitter& Emitter::mov(Mem dst, Reg src) {
+    rex(true, src, 0, dst.base);
+    emit(0x89);
+    modrm_mem(src, dst);
+    return *this;
+}
+
+Emitter& Emitter::mov(Reg dst, uint32_t imm) {
+    rex(false, 0, 0, dst);
+    emit(0xB8 | (dst & 7));
+    emit32(imm);
+    return *this;
+}
+
+Emitter& Emitter::movzxb(Reg dst, Mem src) {
+    rex(false, dst, 0, src.base);
+    bytes({0x0F, 0xB6});
+    modrm_mem(dst, src);
+    return *this;
+}
+
+Emitter& Emitter::movzxw(Reg dst, Mem src) {
+    rex(false, dst, 0, src.base);
+    bytes({0x0F, 0xB7});
+    modrm_mem(dst, src);
+    return *this;
+}
+
+Emitter& Emitter::movl(Reg dst, Mem src) {
+    rex(false, dst, 0, src.base);
+    emit(0x8B);
+    modrm_mem(dst, src);
+    return *this;
+}
+
+Emitter& Emitter::movb(Mem dst, Reg src) {
+    // without a REX prefix, 4 to 7 would be ah, ch, dh and bh rather than spl, bpl, sil and dil
+    rex(false, src, 0, dst.base, src >= RSP && src <= RDI);
+    emit(0x88);
+    modrm_mem(src, dst);
+    return *this;
+}
+
+Emitter& Emitter::movw(Mem dst, Reg src) {
+    emit(0x66);
+    return movl(dst, src);
+}
+
+Emitter& Emitter::movl(Mem dst, Reg src) {
+    rex(false, src, 0, dst.base);
+    emit(0x89);
+    modrm_mem(src, dst);
+    return *this;
+}
+
+Emitter& Emitter::add(Reg dst, Reg src) {
+    rex(true, src, 0, dst);
+    emit(0x01);
+    modrm_reg(src, dst);
+    return *this;
+}
+
+Emitter& Emitter::add(Reg dst, int32_t imm) {
+    alu_imm(0, dst, imm);
+    return *this;
+}
+
+Emitter& Emitter::sub(Reg dst, int32_t imm) {
+    alu_imm(5, dst, imm);
+    return *this;
+}
+
+Emitter& Emitter::imul(Reg dst, Reg src) {
+    rex(true, dst, 0, src);
+    bytes({0x0F, 0xAF});
+    modrm_reg(dst, src);
+    return *this;
+}
+
+Emitter& Emitter::xor_(Reg dst, Reg src) {
+    rex(false, src, 0, dst);
+    emit(0x31);
+    modrm_reg(src, dst);
+    return *this;
+}
+
+Emitter& Emitter::cmp(Reg a, Reg b) {
+    rex(true, b, 0, a);
+    emit(0x39);
+    modrm_reg(b, a);
+    return *this;
+}
+
+Emitter& Emitter::test(Reg a, Reg b) {
+    rex(true, b, 0, a);
+    emit(0x85);
+    modrm_reg(b, a);
+    return *this;
+}
+
+Emitter& Emitter::cmovae(Reg dst, Reg src) {
+    rex(true, dst, 0, src);
+    bytes({0x0F, 0x43});
+    modrm_reg(dst, src);
+    return *this;
+}
+
+Emitter& Emitter::dec(Reg r) {
+    rex(true, 0, 0, r);
+    emit(0xFF);
+    modrm_reg(1, r);
+    return *this;
+}
+
+Emitter& Emitter::lea(Reg dst, Label target) {
+    assert(target.offset <= code_.size());
+    rex(true, dst, 0, 0);
+    emit(0x8D);
+    emit(0x05 | ((dst & 7) << 3));
+    emit32(target.offset - (code_.size() + 4));
+    return *this;
+}
+
+Fixup Emitter::lea_forward(Reg dst) {
+    rex(true, dst, 0, 0);
+    emit(0x8D);
+    emit(0x05 | ((dst & 7) << 3));
+    emit32(0);
+    return Fixup{code_.size() - 4, false};
+}
+
+Emitter& Emitter::push(Reg r) {
+    rex(false, 0, 0, r);
+    emit(0x50 | (r & 7));
+    return *this;
+}
+
+Emitter& Emitter::pop(Reg r) {
+    rex(false, 0, 0, r);
+    emit(0x58 | (r & 7));
+    return *this;
+}
+
+Emitter& Emitter::lfence() {
+    return bytes({0x0F, 0xAE, 0xE8});
+}
+
+Emitter& Emitter::ud2() {
+    return bytes({0x0F, 0x0B});
+}
+
+Emitter& Emitter::ret() {
+    emit(0xC3);
+    return *this;
+}
+
+Emitter& Emitter::vpxor(Vec dst, Vec src1, Vec src2) {
+    vex(dst.n, src1.n, src2.n, true, 1);
+    emit(0xEF);
+    modrm_reg(dst.n, src2.n);
+    return *this;
+}
+
+Emitter& Emitter::vpaddb(Vec dst, Vec src1, Mem src2) {
+    vex(dst.n, src1.n, src2.base, true, 1);
+    emit(0xFC);
+    modrm_mem(dst.n, src2);
+    return *this;
+}
+
+Emitter& Emitter::vmovdqu(Vec dst, Mem src, int bits) {
+    if (bits == 512) {
+        evex512(dst.n, src.base, 2, true);
+        emit(0x6F);
+        modrm_mem(dst.n, src, 64);
+    } else {
+        vex(dst.n, 0, src.base, bits == 256, 2);
+        emit(0x6F);
+        modrm_mem(dst.n, src);
+    }
+    return *this;
+}
+
+Emitter& Emitter::vmovdqu(Mem dst, Vec src, int bits) {
+    if (bits == 512) {
+        evex512(src.n, dst.base, 2, true);
+        emit(0x7F);
+        modrm_mem(src.n, dst, 64);
+    } else {
+        vex(src.n, 0, dst.base, bits == 256, 2);
+        emit(0x7F);
+        modrm_mem(src.n, dst);
+    }
+    return *this;
+}
+
+Emitter& Emitter::vmovq(Reg dst, Vec src) {
+    vex(src.n, 0, dst, false, 1, true);
+    emit(0x7E);
+    modrm_reg(src.n, dst);
+    return *this;
+}
+
+Emitter& Emitter::vmovq(Vec dst, Reg src) {
+    vex(dst.n, 0, src, false, 1, true);
+    emit(0x6E);
+    modrm_reg(dst.n, src);
+    return *this;
+}
+
+Emitter& Emitter::vzeroupper() {
+    return bytes({0xC5, 0xF8, 0x77});
+}
+
+std::shared_ptr<Code> Emitter::finish(bool huge) const {
+    size_t page = huge ? HUGE_PAGE_SIZE : sysconf(_SC_PAGESIZE);
+    size_t size = (code_.size() + page - 1) / page * page;
+    // for huge, map an extra 2 MiB and unmap what lies outside the aligned region
+    size_t extra = huge ? HUGE_PAGE_SIZE : 0;
+    char *p = static_cast<char *>(mmap(nullptr, size + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("mmap failed in jit::Emitter::finish: " + errno_to_str(errno));
+    }
+    if (huge) {
+        char *aligned = p + (HUGE_PAGE_SIZE - (uintptr_t)p % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+        if (aligned > p) {
+            munmap(p, aligned - p);
+        }
+        if (aligned + size < p + size + extra) {
+            munmap(aligned + size, p + size + extra - (aligned + size));
+        }
+        p = aligned;
+        madvise(p, size, MADV_HUGEPAGE);
+    }
+    auto code = std::make_shared<Code>(p, size);
+    std::memcpy(p, code_.data(), code_.size());
+    if (mprotect(p, size, PROT_READ | PROT_EXEC)) {
+        throw std::runtime_error("mprotect failed in jit::Emitter::finish: " + errno_to_str(errno));
+    }
+    return code;
+}
+
+std::shared_ptr<Code> Emitter::finish_aliased() const {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (code_.size() + page - 1) / page * page;
+    int fd = memfd_create("uarch-bench-jit", 0);
+    if (fd == -1) {
+        throw std::runtime_error("memfd_create failed in jit::Emitter::finish_aliased: " + errno_to_str(errno));
+    }
+    if (ftruncate(fd, size)) {
+        close(fd);
+        throw std::runtime_error("ftruncate failed in jit::Emitter::finish_aliased: " + errno_to_str(errno));
+    }
+    void *w = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    void *x = mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+    close(fd);
+    if (w == MAP_FAILED || x == MAP_FAILED) {
+        int err = errno;
+        if (w != MAP_FAILED) {
+            munmap(w, size);
+        }
+        if (x != MAP_FAILED) {
+            munmap(x, size);
+        }
+        throw std::runtime_error("mmap failed in jit::Emitter::finish_aliased: " + errno_to_str(err));
+    }
+    std::memcpy(w, code_.data(), code_.size());
+    return std::make_shared<Code>(x, size, w);
+}
+
+}
+
+long jit_call(uint64_t iters, void *arg) {
+    JitCall *call = static_cast<JitCall *>(arg);
+    return call->code->get()(iters, call->arg);
+}
@@ -0,0 +1,202 @@
+/*
+ * jit.hpp
+ *
+ * A small x86-64 code emitter for generating benchmark loops at runtime from parameters (unroll factors, offsets,
+ * instruction sequences) which would otherwise be %defines in the asm files, needing a rebuild per value.
+ *
+ * Code is written to a read-write mapping which is flipped to read-execute (never both) when finished, and the
+ * result is an ordinary bench2_f. Since a DeltaMaker needs its method as a template argument, generated benchmarks
+ * are registered as jit_call with a JitCall as their arg, which calls through to the generated function.
+ */
+
+#ifndef JIT_HPP_
+#define JIT_HPP_
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "bench-declarations.h"
+
+namespace jit {
+
+enum Reg { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+/* a vector register, xmm, ymm or zmm depending on the instruction */
+struct Vec {
+    int n;
+};
+
+/* a [base + disp] memory operand */
+struct Mem {
+    Reg base;
+    int32_t disp;
+};
+
+inline Mem ptr(Reg base, int32_t disp = 0) {
+    return Mem{base, disp};
+}
+
+/* a position in the code, for jump targets */
+struct Label {
+    size_t offset;
+};
+
+/* a forward jump whose target is set later by bind() */
+struct Fixup {
+    /* the offset of the displacement, and whether it is rel8 (otherwise rel32) */
+    size_t offset;
+    bool short_jump;
+};
+
+/* executable code, which is unmapped when the last reference goes away */
+class Code {
+    void *base_;
+    size_t size_;
+    /* the writable view of the same memory, for code from finish_aliased(), otherwise null */
+    void *alias_;
+public:
+    Code(void *base, size_t size, void *alias = nullptr) : base_{base}, size_{size}, alias_{alias} {}
+    Code(const Code&) = delete;
+    Code& operator=(const Code&) = delete;
+    ~Code();
+
+    bench2_f *get() const { return reinterpret_cast<bench2_f *>(base_); }
+
+    /* the size of the mapping, a whole number of pages */
+    size_t size() const { return size_; }
+
+    /* the address of the given label in this code, e.g., to build a table of jump targets */
+    void *at(Label l) const { return static_cast<char *>(base_) + l.offset; }
+
+    /* the address of the given label in the writable view, only for code from finish_aliased() */
+    void *writable(Label l) const { return static_cast<char *>(alias_) + l.offset; }
+};
+
+/*
+ * Accumulates machine code, one method per instruction form. Only the forms benchmarks have needed so far are here,
+ * add more as required; anything else can be emitted with bytes().
+ */
+class Emitter {
+    std::vector<uint8_t> code_;
+
+    void emit(uint8_t b) { code_.push_back(b); }
+    void emit32(uint32_t v);
+    void rex(bool w, int reg, int index, int base, bool force = false);
+    void vex(int reg, int vvvv, int base, bool l, int pp, bool w = false);
+    void evex512(int reg, int base, int pp, bool w);
+    void modrm_reg(int reg, int rm);
+    /* disp_scale is the EVEX disp8 scale, the memory operand size */
+    void modrm_mem(int reg, Mem m, int disp_scale = 1);
+    void alu_imm(int ext, Reg r, int32_t imm);
+    void jcc(uint8_t cc, Label target);
+    Fixup jcc_forward(uint8_t cc, bool short_jump);
+
+public:
+    /* the current position, to bind a label to */
+    Label here() const { return Label{code_.size()}; }
+    size_t size() const { return code_.size(); }
+    const std::vector<uint8_t>& bytes() const { return code_; }
+
+    Emitter& bytes(std::initializer_list<uint8_t> raw);
+    Emitter& bytes(const std::vector<uint8_t>& raw);
+    /* the recommended multi-byte nop sequences, totalling len bytes */
+    Emitter& nop(size_t len = 1);
+
+    Emitter& mov(Reg dst, Reg src);
+    Emitter& mov(Reg dst, Mem src);
+    Emitter& mov(Mem dst, Reg src);
+    Emitter& mov(Reg dst, uint32_t imm); // 32-bit, zero-extended
+    Emitter& movzxb(Reg dst, Mem src);  // zero-extending byte load
+    Emitter& movzxw(Reg dst, Mem src);  // zero-extending word load
+    Emitter& movl(Reg dst, Mem src);    // 32-bit load, zero-extended
+    Emitter& movb(Mem dst, Reg src);    // byte store
+    Emitter& movw(Mem dst, Reg src);    // word store
+    Emitter& movl(Mem dst, Reg src);    // 32-bit store
+    Emitter& add(Reg dst, Reg src);
+    Emitter& add(Reg dst, int32_t imm);
+    Emitter& sub(Reg dst, int32_t imm);
+    Emitter& imul(Reg dst, Reg src);
+    Emitter& xor_(Reg dst, Reg src);    // 32-bit, so the usual zeroing idiom
+    Emitter& cmp(Reg a, Reg b);
+    Emitter& test(Reg a, Reg b);
+    Emitter& cmovae(Reg dst, Reg src);
+    Emitter& dec(Reg r);
+    Emitter& lea(Reg dst, Label target);  // rip-relative
+    Fixup lea_forward(Reg dst);
+    Emitter& push(Reg r);
+    Emitter& pop(Reg r);
+    Emitter& lfence();
+    Emitter& ud2();
+    Emitter& ret();
+    Emitter& call(Label target);
+    Emitter& call(Mem target);  // indirect, through a pointer in memory
+    Fixup call_forward();
+
+    /* backwards jumps only: the label must already be bound */
+    Emitter& jnz(Label target) { jcc(0x5, target); return *this; }
+    Emitter& jge(Label target) { jcc(0xD, target); return *this; }
+    Emitter& jb (Label target) { jcc(0x2, target); return *this; }
+    /* the target may also be ahead, at an offset the caller has laid out in advance */
+    Emitter& jmp(Label target);
+    Emitter& jmp(Reg target);   // indirect
+    Emitter& jmp(Mem target);   // indirect, through a pointer in memory
+
+    /*
+     * Forward jumps, to the position later passed to bind(): short jumps must land within 127 bytes. The other
+     * *_forward methods, such as call_forward(), work the same way.
+     */
+    Fixup jz_forward (bool short_jump = true) { return jcc_forward(0x4, short_jump); }
+    Fixup jnz_forward(bool short_jump = true) { return jcc_forward(0x5, short_jump); }
+    Fixup jmp_forward(bool short_jump = true);
+    Emitter& bind(Fixup jump);
+
+    Emitter& vpxor (Vec dst, Vec src1, Vec src2);  // ymm
+    Emitter& vpaddb(Vec dst, Vec src1, Mem src2);  // ymm
+    Emitter& vmovdqu(Vec dst, Mem src, int bits = 256);  // xmm, ymm or zmm (as vmovdqu64)
+    Emitter& vmovdqu(Mem dst, Vec src, int bits = 256);  // xmm, ymm or zmm (as vmovdqu64)
+    Emitter& vmovq(Reg dst, Vec src);              // the low qword of an xmm to a gpr
+    Emitter& vmovq(Vec dst, Reg src);              // a gpr to the low qword of an xmm, zeroing the rest
+    Emitter& vzeroupper();
+
+    /*
+     * Copy the code into a fresh mapping and make it executable: the mapping is never writable and executable
+     * at the same time. With huge, the mapping is 2 MiB aligned and rounded up to a multiple of 2 MiB, with an
+     * effort to back it with transparent huge pages (as new_huge_ptr does).
+     */
+    std::shared_ptr<Code> finish(bool huge = false) const;
+
+    /*
+     * As finish(), but the code is in shared memory which is also mapped a second time, read-write, at
+     * Code::writable(), for benchmarks which modify code while it runs. The executable view itself is still never
+     * writable.
+     */
+    std::shared_ptr<Code> finish_aliased() const;
+};
+
+/*
+ * Emit the usual benchmark loop around body: a label, the body, dec rdi, jnz to the label. The function prologue
+ * and epilogue (and the ret) are up to the caller.
+ */
+template <typename F>
+void loop(Emitter& e, F body) {
+    Label top = e.here();
+    body(e);
+    e.dec(RDI).jnz(top);
+}
+
+}
+
+/* the arg for jit_call: the generated function and its own arg */
+struct JitCall {
+    std::shared_ptr<jit::Code> code;
+    void *arg;
+};
+
+extern "C" {
+/* a bench2_f which calls the generated code in the JitCall passed as its arg */
+bench2_f jit_call;
+}
+
+#endif /* JIT_HPP_ */
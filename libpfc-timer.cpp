@@ -69,22 +69,19 @@ void LibpfcTimer::init(Context& c) {
         }
     }
 
+    if (args.ports) {
+        init_ports(c);
+    }
+
     for (auto& e : all_events) {
         metric_names_.push_back(e.short_name);
     }
-
-    PFC_CFG  cfg[7] = {};
-
-    for (auto& event : all_events) {
-        assert(event.slot < TOTAL_COUNTERS);
-        cfg[event.slot] = event.code;
+    if (ports_mode) {
+        metric_names_.resize(1);
+        metric_names_.insert(metric_names_.end(), port_info.labels.begin(), port_info.labels.end());
     }
 
-    err = pfcWrCfgs(0, sizeof(cfg)/sizeof(cfg[0]), cfg);
-    if (err) {
-        const char* msg = pfcErrorString(err);
-        throw std::runtime_error(std::string("pfcWrCfgs() failed (error ") + std::to_string(err) + ": " + msg + ")");
-    }
+    program();
 
     c.out()   << "libpfc timer init OK" << endl;
 
@@ -107,6 +104,65 @@ void LibpfcTimer::init(Context& c) {
     //    }
 }
 
+void LibpfcTimer::program() const {
+    PFC_CFG  cfg[7] = {};
+
+    for (auto& event : all_events) {
+        assert(event.slot < TOTAL_COUNTERS);
+        cfg[event.slot] = event.code;
+    }
+
+    auto err = pfcWrCfgs(0, sizeof(cfg)/sizeof(cfg[0]), cfg);
+    if (err) {
+        const char* msg = pfcErrorString(err);
+        throw std::runtime_error(std::string("pfcWrCfgs() failed (error ") + std::to_string(err) + ": " + msg + ")");
+    }
+}
+
+void LibpfcTimer::init_ports(Context& c) {
+    if (all_events.size() > 1) {
+        c.err() << "--extra-events are ignored with --ports" << endl;
+        all_events.erase(all_events.begin() + 1, all_events.end());
+    }
+
+    port_info = port_events();
+    std::string names;
+    for (auto& e : port_info.pfm4_events()) {
+        names += (names.empty() ? "" : ",") + e;
+    }
+    auto events = parseExtraEvents(c, names);
+    if (events.size() != port_info.events.size()) {
+        throw std::runtime_error("unable to resolve all the port events: " + names);
+    }
+    port_passes = split_passes(events, GP_COUNTERS);
+    for (auto& pass : port_passes) {
+        for (size_t i = 0; i < pass.size(); i++) {
+            pass[i].slot = FIXED_COUNTERS + i;
+        }
+    }
+    ports_mode = true;
+    all_events.insert(all_events.end(), port_passes[0].begin(), port_passes[0].end());
+
+    c.out() << "Counting uops per port (" << names << ") in " << port_passes.size() << " passes" << endl;
+}
+
+unsigned LibpfcTimer::getPassCount() const {
+    return ports_mode ? port_passes.size() : 1;
+}
+
+void LibpfcTimer::setPass(unsigned pass) const {
+    if (ports_mode && pass != current_pass) {
+        all_events.erase(all_events.begin() + 1, all_events.end());
+        all_events.insert(all_events.end(), port_passes.at(pass).begin(), port_passes.at(pass).end());
+        program();
+        current_pass = pass;
+    }
+}
+
+std::string LibpfcTimer::annotate(const TimingResult& result) const {
+    return ports_mode ? port_bottleneck(result, port_info) : std::string();
+}
+
 void LibpfcTimer::listEvents(Context& c) {
     c.out() << "Events supported by libpfc timer on this hardware:" << endl;
     listPfm4Events(c);
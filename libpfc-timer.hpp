@@ -12,6 +12,7 @@
 
 #include "timer-info.hpp"
 #include "libpfm4-support.hpp"
+#include "port-events.hpp"
 
 #if USE_LIBPFC
 #include "libpfc/include/libpfc.h"
@@ -75,8 +76,26 @@ public:
     /////////////////////////
 
     virtual void listEvents(Context& c) override;
+
+    virtual unsigned getPassCount() const override;
+
+    virtual void setPass(unsigned pass) const override;
+
+    virtual std::string annotate(const TimingResult& result) const override;
+
 private:
-    std::vector<PmuEvent> all_events;
+    /* the events currently programmed, cycles first: with --ports, those of the current pass */
+    mutable std::vector<PmuEvent> all_events;
+
+    /* with --ports, the port events and the events of each pass, at most GP_COUNTERS per pass */
+    bool ports_mode = false;
+    PortEvents port_info;
+    std::vector<std::vector<PmuEvent>> port_passes;
+    mutable unsigned current_pass = 0;
+
+    void init_ports(Context& c);
+    /* write the PMU configuration for all_events */
+    void program() const;
 };
 
 #endif
@@ -6,6 +6,7 @@
 #include <cassert>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 #include "benchmark.hpp"
 #include "hedley.h"
@@ -34,32 +35,52 @@ bench2_f load512_any; // AVX512F 512-bit load
 using namespace std;
 
 /*
- * A specialization of BenchmarkGroup that outputs its results in a 4 x 16 grid for all 64 possible
- * offsets within a 64B cache line.
+ * The 64 offsets covered by one LoadStoreGroup grid: offsets first to first + 63 from a pointer aligned to base,
+ * in memory backed by huge (2 MiB) or 4 KiB pages.
+ */
+struct OffsetWindow {
+    size_t base;
+    size_t first;
+    bool huge;
+
+    /* every offset within a 64B cache line */
+    static OffsetWindow cache_line() { return { 64, 0, true }; }
+
+    /* the last 32 and first 32 bytes of a 4K page, so every access width up to 32 bytes splits the page at some offset */
+    static OffsetWindow page_split(bool huge) { return { 4096, 4096 - 32, huge }; }
+};
+
+/*
+ * A specialization of BenchmarkGroup that outputs its results in a 4 x 16 grid for 64 consecutive offsets,
+ * by default all the possible offsets within a 64B cache line.
  */
 class LoadStoreGroup : public BenchmarkGroup {
     static constexpr unsigned DEFAULT_ROWS =  4;
     static constexpr unsigned DEFAULT_COLS = 16;
 
     unsigned rows_, cols_, op_size_;
+    OffsetWindow window_;
 public:
-    LoadStoreGroup(const string& id, const string& name, unsigned op_size, unsigned rows, unsigned cols)
-: BenchmarkGroup(id, name), rows_(rows), cols_(cols), op_size_(op_size) {
+    LoadStoreGroup(const string& id, const string& name, unsigned op_size, unsigned rows, unsigned cols, OffsetWindow window)
+: BenchmarkGroup(id, name), rows_(rows), cols_(cols), op_size_(op_size), window_(window) {
         assert(rows < 10000 && cols < 10000);
     }
 
     HEDLEY_NEVER_INLINE std::string make_name(ssize_t misalign);
     HEDLEY_NEVER_INLINE std::string make_id(ssize_t misalign);
 
-    HEDLEY_NEVER_INLINE static shared_ptr<LoadStoreGroup> make_group(const string& id, const string& name, ssize_t op_size);
+    HEDLEY_NEVER_INLINE static shared_ptr<LoadStoreGroup> make_group(const string& id, const string& name, ssize_t op_size,
+            OffsetWindow window);
 
     template<typename TIMER, bench2_f METHOD>
-    static shared_ptr<LoadStoreGroup> make(const string& id, unsigned op_size, featurelist_t features = {}) {
-        shared_ptr<LoadStoreGroup> group = make_group(id, id, op_size);
+    static shared_ptr<LoadStoreGroup> make(const string& id, unsigned op_size, featurelist_t features = {},
+            OffsetWindow window = OffsetWindow::cache_line()) {
+        shared_ptr<LoadStoreGroup> group = make_group(id, id, op_size, window);
         auto maker = DeltaMaker<TIMER>(group.get(), 1000).setFeatures(features);
-        for (ssize_t misalign = 0; misalign < 64; misalign++) {
+        size_t required = window.first + DEFAULT_ROWS * DEFAULT_COLS + op_size;
+        for (ssize_t misalign = window.first; misalign < (ssize_t)(window.first + DEFAULT_ROWS * DEFAULT_COLS); misalign++) {
             maker.template make<METHOD>(group->make_id(misalign), group->make_name(misalign), 128,
-                    [misalign]() { return misaligned_ptr(64, 64,  misalign); });
+                    [=]() { return misaligned_ptr(window.base, required, misalign, window.huge); });
         }
         return group;
     }
@@ -81,9 +102,14 @@ public:
 
         std::ostream& os = c.out();
         os << endl << "** Inverse throughput for " << getDescription() << " **" << endl;
+        if (window_.base != 64) {
+            os << "offsets from a " << window_.base << "-byte aligned address, " << (window_.huge ? "2M" : "4K")
+                    << " pages" << endl;
+        }
 
         // column headers
-        os << "offset  ";
+        int label_width = std::max<int>(3, std::to_string(window_.first + rows_ * cols_).size());
+        os << setw(label_width + 5) << left << "offset" << right;
         for (unsigned col = 0; col < cols_; col++) {
             os << setw(5) << col;
         }
@@ -99,7 +125,7 @@ public:
         }
 
         for (unsigned row = 0, i = 0; row < rows_; row++) {
-            os << setw(3) << (row * cols_) << " :   ";
+            os << setw(label_width) << (window_.first + row * cols_) << " :   ";
             for (unsigned col = 0; col < cols_; col++, i++) {
                 os << setprecision(1) << fixed << setw(5) << results[i];
             }
@@ -130,8 +156,9 @@ public:
 constexpr unsigned LoadStoreGroup::DEFAULT_ROWS;
 constexpr unsigned LoadStoreGroup::DEFAULT_COLS;
 
-shared_ptr<LoadStoreGroup> LoadStoreGroup::make_group(const string& id, const string& name, ssize_t op_size) {
-    return make_shared<LoadStoreGroup>(id, name, op_size, DEFAULT_ROWS, DEFAULT_COLS);
+shared_ptr<LoadStoreGroup> LoadStoreGroup::make_group(const string& id, const string& name, ssize_t op_size,
+        OffsetWindow window) {
+    return make_shared<LoadStoreGroup>(id, name, op_size, DEFAULT_ROWS, DEFAULT_COLS, window);
 }
 
 std::string LoadStoreGroup::make_name(ssize_t misalign) {
@@ -163,6 +190,25 @@ void register_loadstore(GroupList& list) {
     list.push_back(LoadStoreGroup::make<TIMER, store128_any>("store/128-bit", 16));
     list.push_back(LoadStoreGroup::make<TIMER, store256_any>("store/256-bit", 32));
     list.push_back(LoadStoreGroup::make<TIMER, store512_any>("store/512-bit", 64, { x86Feature::AVX512F }));
+
+    // the same across a 4K boundary, once with 4K pages (a page split) and once within a 2M page
+    for (bool huge : {false, true}) {
+        auto window = OffsetWindow::page_split(huge);
+        string suffix = huge ? "-2m-pages" : "-4k-pages";
+        list.push_back(LoadStoreGroup::make<TIMER,  load16_any>("load-split/16-bit"  + suffix,  2, {}, window));
+        list.push_back(LoadStoreGroup::make<TIMER,  load32_any>("load-split/32-bit"  + suffix,  4, {}, window));
+        list.push_back(LoadStoreGroup::make<TIMER,  load64_any>("load-split/64-bit"  + suffix,  8, {}, window));
+        list.push_back(LoadStoreGroup::make<TIMER, load128_any>("load-split/128-bit" + suffix, 16, {}, window));
+        list.push_back(LoadStoreGroup::make<TIMER, load256_any>("load-split/256-bit" + suffix, 32, {}, window));
+        list.push_back(LoadStoreGroup::make<TIMER, load512_any>("load-split/512-bit" + suffix, 64, { x86Feature::AVX512F }, window));
+
+        list.push_back(LoadStoreGroup::make<TIMER,  store16_any>("store-split/16-bit"  + suffix,  2, {}, window));
+        list.push_back(LoadStoreGroup::make<TIMER,  store32_any>("store-split/32-bit"  + suffix,  4, {}, window));
+        list.push_back(LoadStoreGroup::make<TIMER,  store64_any>("store-split/64-bit"  + suffix,  8, {}, window));
+        list.push_back(LoadStoreGroup::make<TIMER, store128_any>("store-split/128-bit" + suffix, 16, {}, window));
+        list.push_back(LoadStoreGroup::make<TIMER, store256_any>("store-split/256-bit" + suffix, 32, {}, window));
+        list.push_back(LoadStoreGroup::make<TIMER, store512_any>("store-split/512-bit" + suffix, 64, { x86Feature::AVX512F }, window));
+    }
 }
 
 #define REG_LOADSTORE(CLOCK) template void register_loadstore<CLOCK>(GroupList& list);
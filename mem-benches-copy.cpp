@@ -0,0 +1,392 @@
+/*
+ * mem-benches-copy.cpp
+ *
+ * Bulk copy and fill bandwidth: glibc memcpy/memmove/memset, rep movsb/stosb and simple AVX2/AVX-512 loops with
+ * and without non-temporal stores. The memory/copy group sweeps the size from 1 byte to 1 GiB and reports which
+ * kernel is fastest at each size, and the memory/copy-align groups show a grid of bytes/cycle for each source or
+ * destination misalignment within a cache line, in the style of the load/ and store/ groups.
+ */
+
+#include <cstring>
+#include <iomanip>
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "table.hpp"
+#include "simple-timer.hpp"
+#include "isa-support.hpp"
+
+extern "C" {
+bench2_f rep_movsb_copy;
+bench2_f rep_stosb_fill;
+bench2_f avx2_copy;
+bench2_f avx2_copy_nt;
+bench2_f avx512_copy;
+bench2_f avx512_copy_nt;
+bench2_f avx2_fill;
+bench2_f avx2_fill_nt;
+bench2_f avx512_fill;
+bench2_f avx512_fill_nt;
+}
+
+using namespace std;
+
+/* the argument for all the copy and fill kernels, mirror of copy_args in x86_helpers.asm */
+struct CopyArgs {
+    void *dst;
+    const void *src;
+    size_t size;
+};
+
+/* the largest size in the sweep, and the size of each of the source and destination buffers */
+constexpr size_t COPY_MAX_SIZE     = 1024 * 1024 * 1024;
+/* the size sweep copies about this many bytes per sample ... */
+constexpr size_t COPY_SAMPLE_BYTES = 16 * 1024 * 1024;
+/* ... but with at most this many copies per sample, so the smallest sizes don't take forever */
+constexpr size_t COPY_MAX_ITERS    = 10000;
+/* the copy size for the misalignment grids */
+constexpr size_t COPY_GRID_SIZE    = 4096;
+/* the fastest kernel at the previous size stays the fastest unless it falls below this fraction of the best */
+constexpr double COPY_TIE_RATIO    = 0.95;
+
+/* the compiler barrier stops the copies being combined or hoisted out of the loop */
+long libc_memcpy(uint64_t iters, void *arg) {
+    auto a = static_cast<CopyArgs*>(arg);
+    for (uint64_t i = 0; i < iters; i++) {
+        memcpy(a->dst, a->src, a->size);
+        asm volatile ("" ::: "memory");
+    }
+    return 0;
+}
+
+long libc_memmove(uint64_t iters, void *arg) {
+    auto a = static_cast<CopyArgs*>(arg);
+    for (uint64_t i = 0; i < iters; i++) {
+        memmove(a->dst, a->src, a->size);
+        asm volatile ("" ::: "memory");
+    }
+    return 0;
+}
+
+long libc_memset(uint64_t iters, void *arg) {
+    auto a = static_cast<CopyArgs*>(arg);
+    for (uint64_t i = 0; i < iters; i++) {
+        memset(a->dst, 0x5a, a->size);
+        asm volatile ("" ::: "memory");
+    }
+    return 0;
+}
+
+/*
+ * All the kernels: method, id, description, is it a fill (as opposed to a copy), required features. A kernel
+ * whose id ends in "-nt" is compared against the one with the same id without the suffix.
+ */
+#define COPY_KERNELS_X(f) \
+    f(libc_memcpy,    "memcpy",          "glibc memcpy",            false, {}        ) \
+    f(libc_memmove,   "memmove",         "glibc memmove",           false, {}        ) \
+    f(rep_movsb_copy, "rep-movsb",       "rep movsb",               false, {}        ) \
+    f(avx2_copy,      "avx2-copy",       "AVX2 copy loop",          false, {AVX2}    ) \
+    f(avx2_copy_nt,   "avx2-copy-nt",    "AVX2 copy loop, NT",      false, {AVX2}    ) \
+    f(avx512_copy,    "avx512-copy",     "AVX-512 copy loop",       false, {AVX512F} ) \
+    f(avx512_copy_nt, "avx512-copy-nt",  "AVX-512 copy loop, NT",   false, {AVX512F} ) \
+    f(libc_memset,    "memset",          "glibc memset",            true,  {}        ) \
+    f(rep_stosb_fill, "rep-stosb",       "rep stosb",               true,  {}        ) \
+    f(avx2_fill,      "avx2-fill",       "AVX2 fill loop",          true,  {AVX2}    ) \
+    f(avx2_fill_nt,   "avx2-fill-nt",    "AVX2 fill loop, NT",      true,  {AVX2}    ) \
+    f(avx512_fill,    "avx512-fill",     "AVX-512 fill loop",       true,  {AVX512F} ) \
+    f(avx512_fill_nt, "avx512-fill-nt",  "AVX-512 fill loop, NT",   true,  {AVX512F} )
+
+struct CopyKernel {
+    string id, desc;
+    bool fill;
+};
+
+static const vector<CopyKernel>& copy_kernels() {
+#define KERNEL_ENTRY(method, id, desc, fill, features) CopyKernel{id, desc, fill},
+    static const vector<CopyKernel> kernels = { COPY_KERNELS_X(KERNEL_ENTRY) };
+    return kernels;
+}
+
+/* e.g., "64 B", "4 KiB" or "1 GiB" for a power of two size */
+static string size_string(size_t size) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB"};
+    size_t unit = 0;
+    while (size >= 1024 && size % 1024 == 0 && unit < 3) {
+        size /= 1024;
+        unit++;
+    }
+    return std::to_string(size) + " " + units[unit];
+}
+
+/*
+ * Runs every kernel at every size and then prints bytes/cycle tables for the copy and fill kernels, with the
+ * fastest kernel at each size marked, followed by the sizes where the fastest kernel changes (the crossovers)
+ * and where non-temporal stores start to win.
+ */
+class CopySweepGroup : public BenchmarkGroup {
+    /* parallel to getBenches(): the kernel index and size of each benchmark */
+    vector<pair<size_t, size_t>> entries_;
+    CopyArgs args_;
+
+public:
+    CopySweepGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    static vector<size_t> sizes() {
+        vector<size_t> ret;
+        for (size_t size = 1; size <= COPY_MAX_SIZE; size *= 2) {
+            ret.push_back(size);
+        }
+        return ret;
+    }
+
+    /* the copy arguments for the given size, with both buffers aligned to 2 MiB */
+    void *args_for(size_t size) {
+        static char *src = static_cast<char *>(new_huge_ptr(COPY_MAX_SIZE));
+        static char *dst = static_cast<char *>(new_huge_ptr(COPY_MAX_SIZE));
+        args_ = { dst, src, size };
+        return &args_;
+    }
+
+    template <typename TIMER>
+    static shared_ptr<CopySweepGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<CopySweepGroup>(id, desc);
+        CopySweepGroup* g = group.get();
+        auto maker = DeltaMaker<TIMER>(g).setTags({"slow"});
+        size_t kernel = 0;
+#define MAKE_SWEEP(method, id, desc, fill, features)                                                           \
+        for (size_t size : sizes()) {                                                                          \
+            size_t iters = std::max(std::min(COPY_SAMPLE_BYTES / size, COPY_MAX_ITERS), (size_t)1);             \
+            maker.setLoopCount(iters).setFeatures(features).template make<method>(                              \
+                    string_format("%s-%zu", id, size), string_format("%s %s", desc, size_string(size).c_str()),   \
+                    1, [g, size]{ return g->args_for(size); });                                                  \
+            g->entries_.push_back({kernel, size});                                                             \
+        }                                                                                                      \
+        kernel++;
+        COPY_KERNELS_X(MAKE_SWEEP)
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == entries_.size());
+
+        auto& kernels = copy_kernels();
+        auto all_sizes = sizes();
+        // bytes[kernel][size index], 0 if not run
+        vector<vector<double>> bytes(kernels.size(), vector<double>(all_sizes.size()));
+
+        bool header = false;
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b) || !supports(b->getFeatures())) {
+                continue;
+            }
+            if (!header) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                printGroupHeader(c);
+                header = true;
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            size_t kernel = entries_[i].first, size = entries_[i].second;
+            size_t si = std::find(all_sizes.begin(), all_sizes.end(), size) - all_sizes.begin();
+            bytes[kernel][si] = size / result.getCycles();
+        }
+
+        if (!header) {
+            return;
+        }
+
+        c.out() << endl << "rep movsb/stosb support: ERMS " << (supports({ERMS}) ? "yes" : "no")
+                << ", FSRM " << (supports({FSRM}) ? "yes" : "no") << endl;
+        for (bool fill : {false, true}) {
+            printTable(c, fill, all_sizes, bytes);
+        }
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+
+    static void printTable(Context& c, bool fill, const vector<size_t>& sizes, const vector<vector<double>>& bytes) {
+        using namespace table;
+        auto& kernels = copy_kernels();
+        vector<size_t> cols;
+        for (size_t k = 0; k < kernels.size(); k++) {
+            bool any = std::any_of(bytes[k].begin(), bytes[k].end(), [](double v){ return v > 0; });
+            if (kernels[k].fill == fill && any) {
+                cols.push_back(k);
+            }
+        }
+        if (cols.empty()) {
+            return;
+        }
+
+        Table t;
+        auto& header = t.newRow().add("Size");
+        for (size_t k : cols) {
+            header.add(kernels[k].id);
+        }
+
+        // the fastest kernel at each size, or -1 if nothing ran at that size
+        vector<int> best(sizes.size(), -1);
+        for (size_t s = 0; s < sizes.size(); s++) {
+            for (size_t k : cols) {
+                if (bytes[k][s] > 0 && (best[s] == -1 || bytes[k][s] > bytes[best[s]][s])) {
+                    best[s] = k;
+                }
+            }
+            if (best[s] == -1) {
+                continue;
+            }
+            // near-ties go to the previous winner, so that noise doesn't show up as a crossover
+            int prev = s > 0 ? best[s - 1] : -1;
+            if (prev != -1 && bytes[prev][s] >= bytes[best[s]][s] * COPY_TIE_RATIO) {
+                best[s] = prev;
+            }
+            auto& row = t.newRow().add(size_string(sizes[s]));
+            for (size_t k : cols) {
+                row.add(bytes[k][s] > 0 ? string_format("%.2f%s", bytes[k][s], (int)k == best[s] ? "*" : "") : string("-"));
+            }
+        }
+
+        c.out() << endl << (fill ? "Fill" : "Copy") << " bandwidth in bytes/cycle (* marks the fastest at each size):"
+                << endl << t.str();
+
+        c.out() << "Fastest by size (the crossovers):" << endl;
+        vector<size_t> ran;
+        for (size_t s = 0; s < sizes.size(); s++) {
+            if (best[s] != -1) {
+                ran.push_back(s);
+            }
+        }
+        for (size_t i = 0, start = 0; i < ran.size(); i++) {
+            if (i + 1 == ran.size() || best[ran[i + 1]] != best[ran[i]]) {
+                c.out() << string_format("  %10s - %-10s %s", size_string(sizes[ran[start]]).c_str(),
+                        size_string(sizes[ran[i]]).c_str(), kernels[best[ran[i]]].desc.c_str()) << endl;
+                start = i + 1;
+            }
+        }
+
+        // for each non-temporal kernel, the size from which it is faster than its regular counterpart at every size
+        for (size_t nt : cols) {
+            const string& id = kernels[nt].id;
+            if (id.size() < 3 || id.compare(id.size() - 3, 3, "-nt") != 0) {
+                continue;
+            }
+            for (size_t k : cols) {
+                if (kernels[k].id == id.substr(0, id.size() - 3)) {
+                    printNtCrossover(c, sizes, bytes[k], bytes[nt], kernels[nt].desc);
+                }
+            }
+        }
+    }
+
+    static void printNtCrossover(Context& c, const vector<size_t>& sizes, const vector<double>& regular,
+            const vector<double>& nt, const string& desc) {
+        size_t from = sizes.size();
+        for (size_t s = sizes.size(); s-- > 0; ) {
+            if (regular[s] > 0 && nt[s] > 0) {
+                if (nt[s] <= regular[s]) {
+                    break;
+                }
+                from = s;
+            }
+        }
+        c.out() << "  " << desc << ": " << (from == sizes.size() ? string("never faster")
+                : "faster from " + size_string(sizes[from])) << endl;
+    }
+};
+
+/*
+ * A grid of bytes/cycle for a COPY_GRID_SIZE copy (or fill) for each of the 64 misalignments of the source or
+ * destination within a cache line, with the other side aligned. Like LoadStoreGroup this behaves as a single
+ * benchmark as far as the test predicate goes.
+ */
+class CopyAlignGroup : public BenchmarkGroup {
+    static constexpr unsigned ROWS =  4;
+    static constexpr unsigned COLS = 16;
+
+    CopyArgs args_;
+
+public:
+    CopyAlignGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    /* the copy arguments with the given misalignments, in separate 4 KiB aligned halves of the aligned_ptr() storage */
+    void *args_for(ssize_t dst_misalign, ssize_t src_misalign) {
+        size_t half = 2 * COPY_GRID_SIZE;
+        char *src = static_cast<char *>(misaligned_ptr(4096, 2 * half, src_misalign));
+        char *dst = static_cast<char *>(misaligned_ptr(4096, 2 * half, dst_misalign)) + half;
+        args_ = { dst, src, COPY_GRID_SIZE };
+        return &args_;
+    }
+
+    template <typename TIMER, bench2_f METHOD>
+    static shared_ptr<CopyAlignGroup> make(const string& id, const string& desc, bool misalign_dst, featurelist_t features) {
+        auto group = make_shared<CopyAlignGroup>(id, desc);
+        CopyAlignGroup* g = group.get();
+        auto maker = DeltaMaker<TIMER>(g, 1000).setFeatures(features);
+        for (ssize_t misalign = 0; misalign < 64; misalign++) {
+            ssize_t dst = misalign_dst ? misalign : 0, src = misalign_dst ? 0 : misalign;
+            maker.template make<METHOD>(string_format("misaligned-%zd", misalign),
+                    string_format("%s [%2zd]", desc.c_str(), misalign), 1,
+                    [g, dst, src]{ return g->args_for(dst, src); });
+        }
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        auto& benches = getBenches();
+        if (!supports(benches.front()->getFeatures())) {
+            return;
+        }
+
+        Benchmark fake = StaticMaker<DefaultClockTimer>::make_bench<dummy_bench>(this, "fake", getDescription(), 1);
+        if (!predicate(fake)) {
+            return;
+        }
+
+        std::ostream& os = c.out();
+        os << endl << "** Bytes/cycle for " << getDescription() << " **" << endl;
+
+        os << "offset  ";
+        for (unsigned col = 0; col < COLS; col++) {
+            os << setw(6) << col;
+        }
+        os << endl;
+
+        assert(benches.size() == ROWS * COLS);
+
+        vector<double> results(benches.size());
+        for (size_t i = 0; i < benches.size(); i++) {
+            results[i] = COPY_GRID_SIZE / benches[i]->run(c.getTimerInfo()).getCycles();
+        }
+
+        for (unsigned row = 0, i = 0; row < ROWS; row++) {
+            os << setw(3) << (row * COLS) << " :   ";
+            for (unsigned col = 0; col < COLS; col++, i++) {
+                os << setprecision(1) << fixed << setw(6) << results[i];
+            }
+            os << endl;
+        }
+    }
+};
+
+constexpr unsigned CopyAlignGroup::ROWS;
+constexpr unsigned CopyAlignGroup::COLS;
+
+template <typename TIMER>
+void register_mem_copy(GroupList& list) {
+    list.push_back(CopySweepGroup::make<TIMER>("memory/copy", "Copy and fill bandwidth by size"));
+
+#define MAKE_ALIGN(method, id, desc, fill, features)                                                                  \
+    if (!fill) {                                                                                                      \
+        list.push_back(CopyAlignGroup::make<TIMER, method>("memory/copy-align/" id "-src",                            \
+                string_format("%s, %zu bytes, misaligned source", desc, COPY_GRID_SIZE), false, features));            \
+    }                                                                                                                 \
+    list.push_back(CopyAlignGroup::make<TIMER, method>("memory/copy-align/" id "-dst",                                \
+            string_format("%s, %zu bytes, misaligned destination", desc, COPY_GRID_SIZE), true, features));
+    COPY_KERNELS_X(MAKE_ALIGN)
+}
+
+#define REG_DEFAULT(CLOCK) template void register_mem_copy<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -0,0 +1,93 @@
+/*
+ * mem-benches-jit.cpp
+ *
+ * Sweeps of benchmarks generated at runtime by the jit emitter, for parameters which are compile-time %defines in
+ * the asm: memory/bandwidth-jit is bandwidth_test256i from x86_methods2.asm over a range of UNROLLB values, the
+ * sweep that scripts/l2-bandwidth/tricky.sh otherwise does with a rebuild per value.
+ */
+
+#include <cstddef>
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "jit.hpp"
+#include "isa-support.hpp"
+
+using namespace std;
+using namespace jit;
+
+/* the UNROLLB values swept, and the region sizes in KiB */
+constexpr int JIT_MAX_UNROLLB = 50;
+constexpr int JIT_TRICKY_KIB[] = {128, 256};
+
+/*
+ * Emit bandwidth_test256i (see x86_methods2.asm) for the given UNROLLB and UNROLLX: every line is read twice, once
+ * at offset 0 and once at offset 32, with the first read running unroll_b lines ahead of the second.
+ */
+static Emitter emit_bandwidth_tricky(int unroll_b, int unroll_x) {
+    Emitter e;
+    const int32_t size_off = offsetof(region, size), start_off = offsetof(region, start);
+    e.mov(RDX, ptr(RSI, size_off));
+    e.mov(RSI, ptr(RSI, start_off));
+    loop(e, [=](Emitter& e) {
+        e.mov(RAX, RDX);
+        // reduce main loop iterations since the intro/outro parts handle this
+        e.sub(RAX, unroll_b * 64);
+        e.mov(RCX, RSI);
+        e.lfence();
+        e.vpxor(Vec{0}, Vec{0}, Vec{0});
+        e.vpxor(Vec{1}, Vec{1}, Vec{1});
+        e.vpxor(Vec{2}, Vec{1}, Vec{1});
+        // lead-in which reads the first half of the first unroll_b lines
+        for (int i = 0; i < unroll_b; i++) {
+            e.vpaddb(Vec{0}, Vec{0}, ptr(RCX, i * 64));
+        }
+        Label inner = e.here();
+        for (int i = 0; i < unroll_x; i++) {
+            e.vpaddb(Vec{0}, Vec{0}, ptr(RCX, i * 64 + unroll_b * 64));
+        }
+        for (int i = 0; i < unroll_x; i++) {
+            e.vpaddb(Vec{1}, Vec{1}, ptr(RCX, i * 64 + 32));
+        }
+        e.add(RCX, unroll_x * 64);
+        e.sub(RAX, unroll_x * 64);
+        e.jge(inner);
+        // lead-out to read the remaining lines
+        for (int i = 0; i < unroll_b; i++) {
+            e.vpaddb(Vec{0}, Vec{0}, ptr(RCX, i * 64));
+        }
+    });
+    e.vzeroupper();
+    e.ret();
+    return e;
+}
+
+template <typename TIMER>
+void register_mem_jit(GroupList& list) {
+    std::shared_ptr<BenchmarkGroup> group = std::make_shared<BenchmarkGroup>("memory/bandwidth-jit",
+            "Interleaved AVX2 loads by UNROLLB, generated at runtime");
+    list.push_back(group);
+    auto maker = DeltaMaker<TIMER>(group.get(), 1024).setFeatures({AVX2});
+
+    for (int kib : JIT_TRICKY_KIB) {
+        for (int unroll_b = 1; unroll_b <= JIT_MAX_UNROLLB; unroll_b++) {
+            // the code is generated when the benchmark first runs, not at startup
+            auto call = make_shared<JitCall>();
+            maker.template make<jit_call>(
+                    string_format("bandwidth-tricky-%d-u%d", kib, unroll_b),
+                    string_format("%d-KiB interleaved bandwidth, UNROLLB=%d", kib, unroll_b),
+                    kib * 1024 / 64, // timings are per cache line
+                    [=]{
+                        if (!call->code) {
+                            call->code = emit_bandwidth_tricky(unroll_b, 1).finish();
+                        }
+                        call->arg = &shuffled_region(kib * 1024);
+                        return call.get();
+                    });
+        }
+    }
+}
+
+#define REG_DEFAULT(CLOCK) template void register_mem_jit<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -0,0 +1,150 @@
+/*
+ * mem-benches-mlp.cpp
+ *
+ * Memory-level parallelism sweep: 1 to 32 independent pointer chains chased at once through the same shuffled
+ * region, so that the only thing that varies between the benchmarks is the number of misses which can be
+ * outstanding at once. The 1-chain case is exactly the serial-load latency, so the comparison with the serial
+ * tests is apples-to-apples.
+ */
+
+#include <unordered_map>
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "table.hpp"
+#include "simple-timer.hpp"
+
+#define MLP_X(f) \
+    f( 1) f( 2) f( 3) f( 4) f( 5) f( 6) f( 7) f( 8) \
+    f( 9) f(10) f(11) f(12) f(13) f(14) f(15) f(16) \
+    f(17) f(18) f(19) f(20) f(21) f(22) f(23) f(24) \
+    f(25) f(26) f(27) f(28) f(29) f(30) f(31) f(32)
+
+#define DECLARE_MLP(n) bench2_f mlp_chase_ ## n;
+
+extern "C" {
+MLP_X(DECLARE_MLP)
+}
+
+using namespace std;
+
+/* must match MLP_MAX_CHAINS in x86_methods.asm */
+constexpr size_t MLP_MAX_CHAINS = 32;
+/* the footprint of the shuffled region, large enough to miss in the LLC of most machines */
+constexpr size_t MLP_FOOTPRINT = 256 * 1024 * 1024;
+
+static_assert(MLP_FOOTPRINT <= MAX_SHUFFLED_REGION_SIZE, "MAX_SHUFFLED_REGION_SIZE too small");
+
+/*
+ * Runs the chains benchmarks and then prints the per-access cost and effective MLP for each chain count.
+ *
+ * All the chains share one random cycle through the region: the N chains start at equally spaced points
+ * around the cycle, so they never touch the same line at the same time. Each benchmark updates its chain
+ * pointers in place, so successive samples continue around the cycle rather than re-reading recently
+ * accessed (and hence cached) lines.
+ */
+class MlpGroup : public BenchmarkGroup {
+    /* the chain pointers for each chain count, index 0 unused */
+    void *chains_[MLP_MAX_CHAINS + 1][MLP_MAX_CHAINS];
+
+public:
+    MlpGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    template <typename TIMER>
+    static shared_ptr<MlpGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<MlpGroup>(id, desc);
+        MlpGroup* g = group.get();
+        auto maker = DeltaMaker<TIMER>(g, 10 * 1000).setTags({"slow"});
+#define MAKE_MLP(n)                                                                  \
+        maker.template make<mlp_chase_ ## n>("chains-" #n, #n " parallel chains", n,  \
+                [g]{ return static_cast<void *>(g->chains_[n]); });
+        MLP_X(MAKE_MLP)
+        return group;
+    }
+
+    /* build the shuffled region and find the starting points of the chains for every chain count */
+    void prepare() {
+        region& r = shuffled_region(MLP_FOOTPRINT);
+        size_t lines = r.size / UB_CACHE_LINE_SIZE;
+
+        unordered_map<size_t, void *> starts;
+        for (size_t n = 1; n <= MLP_MAX_CHAINS; n++) {
+            for (size_t k = 0; k < n; k++) {
+                starts[k * lines / n] = nullptr;
+            }
+        }
+        CacheLine* p = static_cast<CacheLine*>(r.start);
+        for (size_t i = 0; i < lines; i++, p = p->nexts[0]) {
+            auto it = starts.find(i);
+            if (it != starts.end()) {
+                it->second = p;
+            }
+        }
+        for (size_t n = 1; n <= MLP_MAX_CHAINS; n++) {
+            for (size_t k = 0; k < n; k++) {
+                chains_[n][k] = starts.at(k * lines / n);
+            }
+        }
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == MLP_MAX_CHAINS);
+
+        vector<size_t> counts;
+        vector<double> cycles;
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b)) {
+                continue;
+            }
+            if (counts.empty()) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                prepare();
+                printGroupHeader(c);
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            counts.push_back(i + 1);
+            cycles.push_back(result.getCycles());
+        }
+
+        if (counts.empty()) {
+            return;
+        }
+
+        printCurve(c, counts, cycles);
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+
+    /*
+     * The effective MLP for N chains is the single-chain (serial) latency divided by the cycles per access with N
+     * chains: it levels off at the number of misses the core can have outstanding (fill buffers / MSHRs).
+     */
+    static void printCurve(Context& c, const vector<size_t>& counts, const vector<double>& cycles) {
+        using namespace table;
+        // the serial latency is only known if the 1-chain benchmark ran
+        double serial = counts.front() == 1 ? cycles.front() : 0;
+        Table t;
+        t.newRow().add("Chains").add("Cycles/access").add("Cycles/step").add("Effective MLP");
+        for (size_t i = 0; i < counts.size(); i++) {
+            t.newRow()
+                    .add(counts[i])
+                    .add(string_format("%.2f", cycles[i]))
+                    .add(string_format("%.1f", cycles[i] * counts[i]))
+                    .add(serial ? string_format("%.2f", serial / cycles[i]) : string("-"));
+        }
+        c.out() << endl << string_format("MLP curve (%zu MiB footprint, cycles/step is the latency of one step of each chain):",
+                MLP_FOOTPRINT / 1024 / 1024) << endl << t.str();
+    }
+};
+
+template <typename TIMER>
+void register_mem_mlp(GroupList& list) {
+    list.push_back(MlpGroup::make<TIMER>("memory/mlp", "Memory-level parallelism: independent pointer chains"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_mem_mlp<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -0,0 +1,246 @@
+/*
+ * mem-benches-prefetch.cpp
+ *
+ * Hardware prefetcher characterization: dependent loads which follow a fixed stride, so the only way their
+ * latency is less than a full miss is if a hardware prefetcher recognized the pattern and fetched the lines
+ * ahead of time. Compared against a random chase over the same footprint (which no prefetcher can follow).
+ *
+ * Add prefetch related events with --extra-events (e.g., L2_RQSTS.ALL_PF, L2_RQSTS.PF_MISS or
+ * LOAD_HIT_PRE.SW_PF) to see the prefetcher activity next to each result.
+ */
+
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "table.hpp"
+#include "simple-timer.hpp"
+
+extern "C" {
+bench2_f mlp_chase_1;
+}
+
+using namespace std;
+
+/* the footprint of all the patterns, large enough to miss in the LLC of most machines */
+constexpr size_t PF_FOOTPRINT  = 128 * 1024 * 1024;
+constexpr size_t PF_PAGE_SIZE  = 4096;
+/* a stride is considered to be helped by prefetching if its latency is at most this fraction of the random latency */
+constexpr double PF_HELP_RATIO = 0.5;
+
+/* the access pattern for one benchmark */
+struct PrefetchPattern {
+    /* if true, the stride is followed only within each 4 KiB page, and the pages are visited in random order */
+    bool in_page;
+    bool backward;
+    /* the number of interleaved streams, each in its own equal part of the footprint */
+    size_t streams;
+    size_t stride;
+
+    string layout() const { return in_page ? "in-page" : "linear"; }
+    string dir() const { return backward ? "bwd" : "fwd"; }
+
+    /* the column name for this pattern in the summary tables, e.g., "fwd x4" */
+    string column() const { return dir() + " x" + std::to_string(streams); }
+
+    /*
+     * Return the line indexes of the footprint in visit order. Each stream visits every line of its part: one pass
+     * at the given stride starting at the first line, then a pass starting at the second line and so on.
+     */
+    vector<uint32_t> order() const {
+        size_t part_lines = PF_FOOTPRINT / streams / UB_CACHE_LINE_SIZE;
+        size_t stride_lines = stride / UB_CACHE_LINE_SIZE;
+        size_t block_lines = in_page ? PF_PAGE_SIZE / UB_CACHE_LINE_SIZE : part_lines;
+
+        // the order of the blocks (pages, or the whole part for linear) within each part, the same for every part
+        vector<uint32_t> blocks(part_lines / block_lines);
+        std::iota(blocks.begin(), blocks.end(), 0);
+        std::shuffle(blocks.begin(), blocks.end(), std::mt19937_64{123});
+
+        vector<uint32_t> part;
+        part.reserve(part_lines);
+        for (size_t pass = 0; pass < stride_lines; pass++) {
+            for (uint32_t block : blocks) {
+                for (size_t line = pass; line < block_lines; line += stride_lines) {
+                    part.push_back(block * block_lines + line);
+                }
+            }
+        }
+        assert(part.size() == part_lines);
+        if (backward) {
+            std::reverse(part.begin(), part.end());
+        }
+
+        vector<uint32_t> ret;
+        ret.reserve(part_lines * streams);
+        for (uint32_t idx : part) {
+            for (size_t s = 0; s < streams; s++) {
+                ret.push_back(s * part_lines + idx);
+            }
+        }
+        return ret;
+    }
+};
+
+/*
+ * Runs the random baseline and the strided patterns, then prints the latency of every pattern by stride along
+ * with the largest stride for which the prefetchers still help.
+ */
+class PrefetchGroup : public BenchmarkGroup {
+    /* parallel to getBenches(), except for the first (random) benchmark */
+    vector<PrefetchPattern> patterns_;
+    /* the current chain position, updated by mlp_chase_1 so successive samples keep moving to new lines */
+    void *chain_;
+
+public:
+    PrefetchGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    static CacheLine* storage() {
+        static CacheLine* storage = static_cast<CacheLine*>(new_huge_ptr(PF_FOOTPRINT));
+        return storage;
+    }
+
+    /* link the lines of the storage into a cycle in the given order and return a pointer to the chain position */
+    void *link(const vector<uint32_t>& order) {
+        CacheLine* lines = storage();
+        for (size_t i = 0; i < order.size(); i++) {
+            lines[order[i]].setNexts(&lines[order[(i + 1) % order.size()]]);
+        }
+        chain_ = &lines[order.front()];
+        return &chain_;
+    }
+
+    template <typename TIMER>
+    static shared_ptr<PrefetchGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<PrefetchGroup>(id, desc);
+        PrefetchGroup* g = group.get();
+        auto maker = DeltaMaker<TIMER>(g, 10 * 1000).setTags({"slow"});
+
+        maker.template make<mlp_chase_1>("random", "random order (no prefetching)", 1, [g]{
+            vector<uint32_t> order(PF_FOOTPRINT / UB_CACHE_LINE_SIZE);
+            std::iota(order.begin(), order.end(), 0);
+            std::shuffle(order.begin(), order.end(), std::mt19937_64{123});
+            return g->link(order);
+        });
+
+        for (bool in_page : {false, true}) {
+            for (bool backward : {false, true}) {
+                for (size_t streams : {1, 4, 16}) {
+                    for (size_t stride = 64; stride <= 8192; stride *= 2) {
+                        if (in_page && stride >= PF_PAGE_SIZE) {
+                            continue;
+                        }
+                        PrefetchPattern p{in_page, backward, streams, stride};
+                        maker.template make<mlp_chase_1>(
+                                string_format("%s-%s-x%zu-%zu", p.layout().c_str(), p.dir().c_str(), streams, stride),
+                                string_format("%s %s x%zu stride %zu", p.layout().c_str(), p.dir().c_str(), streams, stride),
+                                1,
+                                [g, p]{ return g->link(p.order()); });
+                        g->patterns_.push_back(p);
+                    }
+                }
+            }
+        }
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == patterns_.size() + 1);
+
+        bool header = false;
+        double random = 0;
+        vector<double> cycles(patterns_.size(), NAN);
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b)) {
+                continue;
+            }
+            if (!header) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                printGroupHeader(c);
+                header = true;
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            (i == 0 ? random : cycles[i - 1]) = result.getCycles();
+        }
+
+        if (!header) {
+            return;
+        }
+
+        for (bool in_page : {false, true}) {
+            printLayout(c, in_page, cycles, random);
+        }
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+
+    /* print the cycles per load for each stride and pattern of the given layout, and the largest helped stride */
+    void printLayout(Context& c, bool in_page, const vector<double>& cycles, double random) {
+        using namespace table;
+        vector<string> columns;
+        vector<size_t> strides;
+        for (auto& p : patterns_) {
+            if (p.in_page == in_page) {
+                if (std::find(columns.begin(), columns.end(), p.column()) == columns.end()) {
+                    columns.push_back(p.column());
+                }
+                if (std::find(strides.begin(), strides.end(), p.stride) == strides.end()) {
+                    strides.push_back(p.stride);
+                }
+            }
+        }
+
+        // cell[stride][column] is the cycles, NAN if not run
+        vector<vector<double>> cell(strides.size(), vector<double>(columns.size(), NAN));
+        for (size_t i = 0; i < patterns_.size(); i++) {
+            auto& p = patterns_[i];
+            if (p.in_page == in_page) {
+                size_t row = std::find(strides.begin(), strides.end(), p.stride) - strides.begin();
+                size_t col = std::find(columns.begin(), columns.end(), p.column()) - columns.begin();
+                cell[row][col] = cycles[i];
+            }
+        }
+
+        Table t;
+        auto& header = t.newRow().add("Stride");
+        for (auto& col : columns) {
+            header.add(col);
+        }
+        for (size_t r = 0; r < strides.size(); r++) {
+            auto& row = t.newRow().add(strides[r]);
+            for (size_t col = 0; col < columns.size(); col++) {
+                row.add(std::isnan(cell[r][col]) ? string("-") : string_format("%.1f", cell[r][col]));
+            }
+        }
+
+        // the largest stride, for each column, at or below which every stride is still helped by prefetching
+        if (random > 0) {
+            auto& row = t.newRow().add("Helped up to");
+            for (size_t col = 0; col < columns.size(); col++) {
+                string helped = "none";
+                for (size_t r = 0; r < strides.size() && cell[r][col] <= random * PF_HELP_RATIO; r++) {
+                    helped = std::to_string(strides[r]);
+                }
+                row.add(helped);
+            }
+        }
+
+        c.out() << endl << (in_page ? "Strided within 4 KiB pages, pages in random order" : "Strided across the whole region")
+                << string_format(", cycles per load (random: %.1f):", random) << endl << t.str();
+    }
+};
+
+template <typename TIMER>
+void register_mem_prefetch(GroupList& list) {
+    list.push_back(PrefetchGroup::make<TIMER>("memory/hw-prefetch", "Hardware prefetcher stride and pattern sweep"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_mem_prefetch<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -0,0 +1,232 @@
+/*
+ * mem-benches-stfwd.cpp
+ *
+ * Store-to-load forwarding over every combination of store width, load width (8 to 512 bits) and the offset of the
+ * load relative to the store, using latency chains generated at runtime by the jit emitter: each iteration stores
+ * a register, loads (part of) it back into the same register, and stores that in the next iteration.
+ *
+ * When the store and the load are in different register files (a gpr store and a vector load, or the reverse), the
+ * chain also includes a vmovq back to the store's register file, so those results include its latency. A result
+ * is flagged as a forwarding failure when it is more than STFWD_STALL_CYCLES over the median of the loads known to
+ * forward with the same register files: those at offset 0 and narrower than the store. Loads of the same width are
+ * left out, since CPUs which rename memory make them faster still, as are contained loads at other offsets, many of
+ * which fail for vectors. A gpr store is never wider than a vector load, so such loads always fail.
+ *
+ * The store is either 64-byte aligned in the middle of a 4 KiB page (line), so loads at negative offsets cross a
+ * line boundary, or at the start of a 4 KiB page (page), so they cross a page boundary.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstddef>
+#include <cmath>
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "jit.hpp"
+#include "isa-support.hpp"
+#include "simple-timer.hpp"
+#include "stats.hpp"
+
+using namespace std;
+using namespace jit;
+
+constexpr int    STFWD_WIDTHS[] = {8, 16, 32, 64, 128, 256, 512};
+/* the offsets of the load from the store, in bytes */
+constexpr int    STFWD_OFFSETS[] = {-32, -16, -8, -4, -2, -1, 0, 1, 2, 4, 8, 16, 32, 48};
+/* the cycles over the loads known to forward (see above) beyond which forwarding is taken to have failed */
+constexpr double STFWD_STALL_CYCLES = 5;
+
+/* the arg for the store forwarding kernel */
+struct StfwdArgs {
+    char *store, *load;
+};
+
+static bool is_vector(int bits) {
+    return bits >= 128;
+}
+
+/* the register files of the store and load, as an index 0 - 3 */
+static int register_files(int store_bits, int load_bits) {
+    return is_vector(store_bits) * 2 + is_vector(load_bits);
+}
+
+static featurelist_t stfwd_features(int store_bits, int load_bits) {
+    int widest = std::max(store_bits, load_bits);
+    return widest == 512 ? featurelist_t{AVX512F} : is_vector(widest) ? featurelist_t{AVX} : featurelist_t{};
+}
+
+/*
+ * One iteration stores rax or xmm0/ymm0/zmm0 (depending on the width) to the store address, then loads from the
+ * load address into the same register, or into the other register file followed by a vmovq back.
+ */
+static Emitter emit_stfwd(int store_bits, int load_bits) {
+    bool vector = is_vector(store_bits) || is_vector(load_bits);
+    Emitter e;
+    e.mov(RDX, ptr(RSI, offsetof(StfwdArgs, store)));
+    e.mov(RCX, ptr(RSI, offsetof(StfwdArgs, load)));
+    e.xor_(RAX, RAX);
+    if (vector) {
+        e.vmovq(Vec{0}, RAX);
+    }
+    loop(e, [=](Emitter& e) {
+        switch (store_bits) {
+        case 8:  e.movb(ptr(RDX), RAX); break;
+        case 16: e.movw(ptr(RDX), RAX); break;
+        case 32: e.movl(ptr(RDX), RAX); break;
+        case 64: e.mov (ptr(RDX), RAX); break;
+        default: e.vmovdqu(ptr(RDX), Vec{0}, store_bits);
+        }
+        switch (load_bits) {
+        case 8:  e.movzxb(RAX, ptr(RCX)); break;
+        case 16: e.movzxw(RAX, ptr(RCX)); break;
+        case 32: e.movl  (RAX, ptr(RCX)); break;
+        case 64: e.mov   (RAX, ptr(RCX)); break;
+        default: e.vmovdqu(Vec{0}, ptr(RCX), load_bits);
+        }
+        if (is_vector(store_bits) && !is_vector(load_bits)) {
+            e.vmovq(Vec{0}, RAX);
+        } else if (!is_vector(store_bits) && is_vector(load_bits)) {
+            e.vmovq(RAX, Vec{0});
+        }
+    });
+    if (vector) {
+        e.vzeroupper();
+    }
+    e.ret();
+    return e;
+}
+
+/*
+ * Runs the benchmarks for every store width, load width and offset at which the load overlaps the store, then
+ * prints the latency in a grid per store width, in the style of LoadStoreGroup, with a row per load width and a
+ * column per offset. Forwarding failures are marked with a *.
+ */
+class StoreForwardGroup : public BenchmarkGroup {
+    struct Point {
+        int store_bits, load_bits, offset;
+    };
+
+    /* parallel to getBenches() */
+    vector<Point> points_;
+
+public:
+    StoreForwardGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    /* page is true to place the store at the start of a page, otherwise in the middle of one */
+    template <typename TIMER>
+    static shared_ptr<StoreForwardGroup> make(const string& id, const string& desc, bool page) {
+        auto group = make_shared<StoreForwardGroup>(id, desc);
+        auto maker = DeltaMaker<TIMER>(group.get(), 1000);
+        for (int store_bits : STFWD_WIDTHS) {
+            for (int load_bits : STFWD_WIDTHS) {
+                for (int offset : STFWD_OFFSETS) {
+                    // only loads which overlap the store depend on it
+                    if (offset >= store_bits / 8 || offset + load_bits / 8 <= 0) {
+                        continue;
+                    }
+                    auto call = make_shared<JitCall>();
+                    auto args = make_shared<StfwdArgs>();
+                    maker.setFeatures(stfwd_features(store_bits, load_bits)).template make<jit_call>(
+                            string_format("store%d-load%d-offset%d", store_bits, load_bits, offset),
+                            string_format("%d-bit store, %d-bit load at %+d", store_bits, load_bits, offset),
+                            1,
+                            [=]{
+                                if (!call->code) {
+                                    call->code = emit_stfwd(store_bits, load_bits).finish();
+                                }
+                                // 4K pages, with room for the negative offsets in the page before the store
+                                char *base = static_cast<char *>(aligned_ptr(4096, 3 * 4096, false));
+                                args->store = base + 4096 + (page ? 0 : 2048);
+                                args->load = args->store + offset;
+                                call->arg = args.get();
+                                return call.get();
+                            });
+                    group->points_.push_back({store_bits, load_bits, offset});
+                }
+            }
+        }
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == points_.size());
+
+        bool header = false;
+        vector<double> cycles(points_.size(), NAN);
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b) || !supports(b->getFeatures())) {
+                continue;
+            }
+            if (!header) {
+                c.out() << std::endl << "** Store forwarding latency for " << getDescription() << " **" << std::endl;
+                header = true;
+            }
+            cycles[i] = b->run(c.getTimerInfo()).getCycles();
+        }
+
+        if (!header) {
+            return;
+        }
+
+        // the median of the loads known to forward for each pair of register files, -inf if there are none
+        vector<double> known[4];
+        for (size_t i = 0; i < points_.size(); i++) {
+            const Point& p = points_[i];
+            if (!std::isnan(cycles[i]) && p.offset == 0 && p.load_bits < p.store_bits) {
+                known[register_files(p.store_bits, p.load_bits)].push_back(cycles[i]);
+            }
+        }
+        double forwarded[4];
+        for (int f = 0; f < 4; f++) {
+            forwarded[f] = known[f].empty() ? -INFINITY : Stats::median(known[f].begin(), known[f].end());
+        }
+
+        std::ostream& os = c.out();
+        for (int store_bits : STFWD_WIDTHS) {
+            os << endl << store_bits << "-bit store, offset of the load:" << endl;
+            os << setw(9) << left << "load" << right;
+            for (int offset : STFWD_OFFSETS) {
+                os << setw(6) << offset;
+            }
+            os << endl;
+            for (int load_bits : STFWD_WIDTHS) {
+                os << setw(3) << load_bits << " :    ";
+                for (int offset : STFWD_OFFSETS) {
+                    double v = NAN;
+                    for (size_t i = 0; i < points_.size(); i++) {
+                        const Point& p = points_[i];
+                        if (p.store_bits == store_bits && p.load_bits == load_bits && p.offset == offset) {
+                            v = cycles[i];
+                        }
+                    }
+                    if (std::isnan(v)) {
+                        os << setw(6) << "-";
+                    } else {
+                        bool stall = v > forwarded[register_files(store_bits, load_bits)] + STFWD_STALL_CYCLES;
+                        os << setprecision(1) << fixed << setw(5) << v << (stall ? "*" : " ");
+                    }
+                }
+                os << endl;
+            }
+        }
+        os << "* forwarding failed: over " << STFWD_STALL_CYCLES << " cycles slower than narrower loads at offset 0"
+                " with the same register files" << endl;
+        os << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+};
+
+template <typename TIMER>
+void register_mem_stfwd(GroupList& list) {
+    list.push_back(StoreForwardGroup::make<TIMER>("memory/store-fwd-matrix/line",
+            "stores 64-byte aligned mid-page", false));
+    list.push_back(StoreForwardGroup::make<TIMER>("memory/store-fwd-matrix/page",
+            "stores at the start of a 4K page", true));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_mem_stfwd<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -0,0 +1,139 @@
+/*
+ * mem-benches-sweep.cpp
+ *
+ * Latency-vs-footprint sweep: serial pointer chasing through shuffled regions at log-spaced footprints,
+ * followed by an automatic inference of the cache levels (latency plateaus) and their capacities (knees).
+ */
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "table.hpp"
+#include "plateaus.hpp"
+#include "simple-timer.hpp"
+
+#include <cmath>
+
+extern "C" {
+bench2_f serial_load_bench;
+}
+
+using namespace std;
+
+/** smallest footprint in the sweep */
+constexpr size_t SWEEP_MIN_BYTES    = 4 * 1024;
+/** number of doublings (octaves) above SWEEP_MIN_BYTES covered by the sweep, i.e., up to 128 MiB */
+constexpr unsigned SWEEP_OCTAVES    = 15;
+/** the maximum (registered) number of points per octave, --sweep-density selects a subset of these */
+constexpr unsigned SWEEP_MAX_DENSITY = 8;
+/** relative tolerance used to decide if two latencies belong to the same plateau */
+constexpr double SWEEP_PLATEAU_TOL  = 0.15;
+/** the last plateau is reported as DRAM when its latency is at least this many times that of the level before */
+constexpr double SWEEP_DRAM_RATIO   = 2.0;
+/** ... and at least this many cycles, beyond the latency of any cache level */
+constexpr double SWEEP_DRAM_CYCLES  = 100.0;
+
+static_assert(SWEEP_MIN_BYTES << SWEEP_OCTAVES <= MAX_SHUFFLED_REGION_SIZE, "MAX_SHUFFLED_REGION_SIZE too small");
+
+/*
+ * A group which runs the serial-load sweep at the density requested with --sweep-density and then prints,
+ * in addition to the usual per-benchmark results, the inferred latency and effective capacity of each
+ * level of the memory hierarchy.
+ */
+class LatencySweepGroup : public BenchmarkGroup {
+    /* footprint in bytes for each benchmark, parallel to getBenches() */
+    vector<size_t> sizes_;
+
+public:
+    LatencySweepGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    template <typename TIMER>
+    static shared_ptr<LatencySweepGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<LatencySweepGroup>(id, desc);
+        auto maker = DeltaMaker<TIMER>(group.get()).setTags({"slow"});
+        for (unsigned point = 0; point <= SWEEP_OCTAVES * SWEEP_MAX_DENSITY; point++) {
+            size_t bytes = SWEEP_MIN_BYTES * std::pow(2.0, (double)point / SWEEP_MAX_DENSITY);
+            bytes -= bytes % UB_CACHE_LINE_SIZE;
+            // one full trip around the cycle per iteration, but at least enough loads to get a stable timing
+            uint32_t loops = std::max(bytes / UB_CACHE_LINE_SIZE, (size_t)100 * 1000);
+            maker.setLoopCount(loops).template make<serial_load_bench>(
+                    string_format("sweep-%zu", bytes),
+                    string_format("%.1f-KiB serial loads", bytes / 1024.0),
+                    1,
+                    [=]{ return &shuffled_region(bytes); }
+            );
+            group->sizes_.push_back(bytes);
+        }
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        unsigned density = c.getSweepDensity();
+        if (density == 0 || density > SWEEP_MAX_DENSITY || !is_pow2(density)) {
+            c.fatal("--sweep-density must be a power of two between 1 and %u, but was %u", SWEEP_MAX_DENSITY, density);
+        }
+        unsigned stride = SWEEP_MAX_DENSITY / density;
+
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        vector<size_t> sizes;
+        vector<double> cycles;
+        for (size_t i = 0; i < benches.size(); i += stride) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b)) {
+                continue;
+            }
+            if (sizes.empty()) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                printGroupHeader(c);
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            sizes.push_back(sizes_.at(i));
+            cycles.push_back(result.getCycles());
+        }
+
+        if (sizes.empty()) {
+            return;
+        }
+
+        printInferred(c, sizes, cycles, density + 1);
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+
+    /*
+     * Print the inferred hierarchy: each plateau is a level, whose effective capacity is the largest footprint
+     * still on the plateau. The last plateau is reported as DRAM if its latency is well past the level before it,
+     * even when the sweep ends in the transition to it, and a plateau which extends to the end of the sweep has no
+     * observed capacity.
+     */
+    static void printInferred(Context& c, const vector<size_t>& sizes, const vector<double>& cycles, size_t min_len) {
+        using namespace table;
+        auto plateaus = find_plateaus(cycles, SWEEP_PLATEAU_TOL, min_len);
+
+        c.out() << endl << "Inferred memory hierarchy (" << plateaus.size() << " levels):" << endl;
+        Table t;
+        t.newRow().add("Level").add("Latency (cycles)").add("Footprint range (KiB)").add("Effective capacity (KiB)");
+        for (size_t l = 0; l < plateaus.size(); l++) {
+            const Plateau& p = plateaus[l];
+            bool unbounded = p.last + 1 == sizes.size();
+            bool dram = l > 0 && l + 1 == plateaus.size() && p.level >= SWEEP_DRAM_CYCLES
+                    && p.level >= SWEEP_DRAM_RATIO * plateaus[l - 1].level;
+            string name = dram ? "DRAM" : "L" + std::to_string(l + 1);
+            t.newRow()
+                    .add(name)
+                    .add(string_format("%.1f", p.level))
+                    .add(string_format("%.1f - %.1f", sizes[p.first] / 1024.0, sizes[p.last] / 1024.0))
+                    .add(unbounded ? string(">= ") + string_format("%.1f", sizes[p.last] / 1024.0) : string_format("%.1f", sizes[p.last] / 1024.0));
+        }
+        c.out() << t.str();
+    }
+};
+
+template <typename TIMER>
+void register_mem_sweep(GroupList& list) {
+    list.push_back(LatencySweepGroup::make<TIMER>("memory/latency-sweep", "Serial load latency vs footprint sweep"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_mem_sweep<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
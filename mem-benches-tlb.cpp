@@ -0,0 +1,145 @@
+/*
+ * mem-benches-tlb.cpp
+ *
+ * TLB reach and page-walk cost: pointer chasing through one cache line per 4 KiB page over a growing number
+ * of pages, once with the region backed by 4 KiB pages and once backed by 2 MiB pages. The cache footprint
+ * (one line per page) is identical in both cases so the difference between the two is the cost of the
+ * 4 KiB translations.
+ *
+ * Add DTLB_LOAD_MISSES.* events with --extra-events to see the misses directly.
+ */
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "table.hpp"
+#include "plateaus.hpp"
+#include "simple-timer.hpp"
+
+extern "C" {
+bench2_f serial_load_bench;
+}
+
+using namespace std;
+
+constexpr size_t TLB_PAGE_SIZE = 4096;
+/** tolerance used to find the plateaus in the 4K - 2M difference, which is close to zero when the DTLB hits */
+constexpr double TLB_PLATEAU_REL_TOL = 0.15;
+constexpr double TLB_PLATEAU_ABS_TOL = 1.5;
+
+/*
+ * Runs the 4K and 2M page-chase benchmarks for each page count and then prints the per-count results side by
+ * side along with the difference (the translation cost), followed by the inferred TLB reaches and costs.
+ */
+class TlbGroup : public BenchmarkGroup {
+    /* the page counts, each has two benchmarks: 4K backed followed by 2M backed */
+    vector<size_t> counts_;
+
+public:
+    TlbGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    template <typename TIMER>
+    static shared_ptr<TlbGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<TlbGroup>(id, desc);
+        auto maker = DeltaMaker<TIMER>(group.get(), 100 * 1000);
+        for (size_t pages = 8; pages * TLB_PAGE_SIZE <= MAX_PAGE_CHASE_SIZE; pages *= 2) {
+            // half steps between the powers of two, to get enough points to find the plateaus
+            for (size_t count : {pages, pages * 3 / 2}) {
+                if (count * TLB_PAGE_SIZE > MAX_PAGE_CHASE_SIZE) {
+                    break;
+                }
+                maker.template make<serial_load_bench>(
+                        string_format("4k-pages-%zu", count),
+                        string_format("%zu 4K pages, 4K backed", count),
+                        1,
+                        [=]{ return &page_chase_region(count, TLB_PAGE_SIZE, false); });
+                maker.template make<serial_load_bench>(
+                        string_format("2m-pages-%zu", count),
+                        string_format("%zu 4K pages, 2M backed", count),
+                        1,
+                        [=]{ return &page_chase_region(count, TLB_PAGE_SIZE, true); });
+                group->counts_.push_back(count);
+            }
+        }
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == counts_.size() * 2);
+
+        vector<size_t> counts;
+        vector<double> small, huge;
+        for (size_t i = 0; i < counts_.size(); i++) {
+            const Benchmark& b4k = benches[i * 2], b2m = benches[i * 2 + 1];
+            if (!predicate(b4k) && !predicate(b2m)) {
+                continue;
+            }
+            if (counts.empty()) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                c.out() << "Transparent huge pages: " << thp_mode() << std::endl;
+                printGroupHeader(c);
+            }
+            TimingResult r4k = b4k->run(c.getTimerInfo()), r2m = b2m->run(c.getTimerInfo());
+            printResultLine(c, b4k, r4k);
+            printResultLine(c, b2m, r2m);
+            counts.push_back(counts_[i]);
+            small.push_back(r4k.getCycles());
+            huge.push_back(r2m.getCycles());
+        }
+
+        if (counts.empty()) {
+            return;
+        }
+
+        printSummary(c, counts, small, huge);
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+
+    /*
+     * The first plateau of the 4K - 2M difference (near zero) is where the translations hit in the TLB, and its
+     * knee is the reach of the TLB hierarchy. Each later plateau is a more expensive miss level, e.g., an STLB hit
+     * when that is distinguishable from an L1 DTLB hit, or a page walk whose paging-structure entries hit in a
+     * further level of cache.
+     */
+    static void printSummary(Context& c, const vector<size_t>& counts, const vector<double>& small, const vector<double>& huge) {
+        using namespace table;
+        vector<double> diff(counts.size());
+        Table t;
+        t.newRow().add("Pages").add("Footprint (KiB)").add("4K backed").add("2M backed").add("Translation cost");
+        for (size_t i = 0; i < counts.size(); i++) {
+            diff[i] = small[i] - huge[i];
+            t.newRow()
+                    .add(counts[i])
+                    .add(counts[i] * TLB_PAGE_SIZE / 1024)
+                    .add(string_format("%.2f", small[i]))
+                    .add(string_format("%.2f", huge[i]))
+                    .add(string_format("%.2f", diff[i]));
+        }
+        c.out() << endl << "Cycles per load by page count:" << endl << t.str();
+
+        auto plateaus = find_plateaus(diff, TLB_PLATEAU_REL_TOL, 2, TLB_PLATEAU_ABS_TOL);
+        Table inferred;
+        inferred.newRow().add("Level").add("Extra cycles per load").add("Reach (pages)").add("Reach (KiB)");
+        for (size_t l = 0; l < plateaus.size(); l++) {
+            const Plateau& p = plateaus[l];
+            bool unbounded = p.last + 1 == counts.size();
+            string name = l == 0 ? "TLB hit" : string_format("Miss level %zu", l);
+            inferred.newRow()
+                    .add(name)
+                    .add(string_format("%.2f", p.level))
+                    .add(unbounded ? string("-") : std::to_string(counts[p.last]))
+                    .add(unbounded ? string("-") : std::to_string(counts[p.last] * TLB_PAGE_SIZE / 1024));
+        }
+        c.out() << endl << "Inferred TLB levels (4K pages):" << endl << inferred.str();
+    }
+};
+
+template <typename TIMER>
+void register_mem_tlb(GroupList& list) {
+    list.push_back(TlbGroup::make<TIMER>("memory/tlb", "TLB reach and page-walk cost (one line per page)"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_mem_tlb<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
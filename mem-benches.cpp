@@ -126,6 +126,27 @@ bench2_f sameloc_pointer_chase_8way45;
 template <typename TIMER>
 void register_mem_oneshot(GroupList& list);
 
+template <typename TIMER>
+void register_mem_sweep(GroupList& list);
+
+template <typename TIMER>
+void register_mem_tlb(GroupList& list);
+
+template <typename TIMER>
+void register_mem_mlp(GroupList& list);
+
+template <typename TIMER>
+void register_mem_prefetch(GroupList& list);
+
+template <typename TIMER>
+void register_mem_copy(GroupList& list);
+
+template <typename TIMER>
+void register_mem_jit(GroupList& list);
+
+template <typename TIMER>
+void register_mem_stfwd(GroupList& list);
+
 
 template <bench2_f F, typename M>
 static void make_load_bench(M& maker, int kib, const char* id_prefix, const char *desc_suffix, uint32_t ops, size_t offset = 0) {
@@ -183,14 +204,13 @@ void register_mem(GroupList& list) {
     }
 
     {
-        // this group of tests is flawed for prefetch1 and prefetch2 and probably prefetchnta in that is highly dependent on the initial cache state.
-        // If the accessed region is in L1 at the start of the test, loads like prefetch1 which would normally leave the only line in L2,
-        // will find it in L1 and be much faster. If the line isn't in L1, it won't get in there and the test will be slower. Each line can be in
-        // either state, so you'll get a range of results somewhere between slow and fast, depending on random factors preceeding the test.
-        // To fix, we could put the region in a consistent state.
+        // prefetch1 and prefetch2 and probably prefetchnta are highly dependent on the initial cache state: if the accessed region is in
+        // L1 at the start of the test, prefetch1 (which would normally leave the line only in L2) will find it in L1 and be much faster,
+        // while a line that isn't in L1 won't get in there. So the region is evicted from L1 before each sample, which gives the "slow"
+        // answer consistently rather than a random mix of the two.
         std::shared_ptr<BenchmarkGroup> group = std::make_shared<BenchmarkGroup>("memory/prefetch-parallel", "Parallel prefetches from fixed-size regions");
         list.push_back(group);
-        auto maker = DeltaMaker<TIMER>(group.get(), 100000).setTags({"default"});
+        auto maker = DeltaMaker<TIMER>(group.get(), 100000).setTags({"default"}).setCacheState(CacheState::L2);
 
         for (auto kib : {16, 32, 64, 128, 256, 512, 2048, 4096, 8192, 8192 * 4}) {
             PFTYPE_X(MAKEP_LOAD,kib)
@@ -360,6 +380,13 @@ void register_mem(GroupList& list) {
     }
 
     register_mem_oneshot<TIMER>(list);
+    register_mem_sweep<TIMER>(list);
+    register_mem_tlb<TIMER>(list);
+    register_mem_mlp<TIMER>(list);
+    register_mem_prefetch<TIMER>(list);
+    register_mem_copy<TIMER>(list);
+    register_mem_jit<TIMER>(list);
+    register_mem_stfwd<TIMER>(list);
 }
 
 #define REG_DEFAULT(CLOCK) template void register_mem<CLOCK>(GroupList& list);
@@ -0,0 +1,145 @@
+/*
+ * numa.cpp
+ */
+
+#include "numa.hpp"
+#include "util.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+/* large enough for any node number we expect to see */
+constexpr int MAX_NODES = 1024;
+constexpr int BITS_PER_WORD = sizeof(unsigned long) * 8;
+
+static MemPolicy current_policy{ MemPolicy::DEFAULT, 0 };
+
+/* a node mask in the format expected by set_mempolicy and mbind */
+struct NodeMask {
+    unsigned long bits[MAX_NODES / BITS_PER_WORD] = {};
+
+    NodeMask(const std::vector<int>& nodes) {
+        for (int node : nodes) {
+            if (node < 0 || node >= MAX_NODES) {
+                throw std::runtime_error(string_format("NUMA node %d out of range", node));
+            }
+            bits[node / BITS_PER_WORD] |= 1UL << (node % BITS_PER_WORD);
+        }
+    }
+
+    unsigned long maxnode() const { return MAX_NODES; }
+};
+
+static std::string read_line(const std::string& path) {
+    std::ifstream f(path);
+    std::string line;
+    std::getline(f, line);
+    return line;
+}
+
+MemPolicy MemPolicy::parse(const std::string& value) {
+    if (value == "interleave") {
+        return { INTERLEAVE, 0 };
+    }
+    size_t end;
+    int node = std::stoi(value, &end);
+    if (end != value.size() || node < 0) {
+        throw std::invalid_argument("bad NUMA node: " + value);
+    }
+    return { BIND, node };
+}
+
+std::string MemPolicy::to_string() const {
+    switch (mode) {
+    case DEFAULT:
+        return "the first-touch node (default)";
+    case BIND:
+        return "node " + std::to_string(node);
+    case INTERLEAVE:
+        return "nodes " + container_to_string(numa_memory_nodes()) + " (interleaved)";
+    }
+    return "unknown";
+}
+
+std::vector<int> numa_memory_nodes() {
+    std::string list = read_line("/sys/devices/system/node/has_memory");
+    if (list.empty()) {
+        list = read_line("/sys/devices/system/node/online");
+    }
+    try {
+        auto nodes = parse_cpu_list(list);
+        if (!nodes.empty()) {
+            return nodes;
+        }
+    } catch (std::invalid_argument&) {}
+    return { 0 };
+}
+
+int numa_node_of_cpu(int cpu) {
+    for (int node : parse_cpu_list(read_line("/sys/devices/system/node/online"))) {
+        std::string cpus = read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        try {
+            for (int c : parse_cpu_list(cpus)) {
+                if (c == cpu) {
+                    return node;
+                }
+            }
+        } catch (std::invalid_argument&) {}
+    }
+    return 0;
+}
+
+/* the mode and nodes to pass to the kernel for the given policy */
+static std::pair<int, std::vector<int>> kernel_policy(const MemPolicy& policy) {
+    switch (policy.mode) {
+    case MemPolicy::BIND:
+        return { MPOL_BIND, { policy.node } };
+    case MemPolicy::INTERLEAVE:
+        return { MPOL_INTERLEAVE, numa_memory_nodes() };
+    default:
+        return { MPOL_DEFAULT, {} };
+    }
+}
+
+void set_mem_policy(const MemPolicy& policy) {
+    auto nodes = numa_memory_nodes();
+    if (policy.mode == MemPolicy::BIND && std::find(nodes.begin(), nodes.end(), policy.node) == nodes.end()) {
+        throw std::runtime_error(string_format("NUMA node %d doesn't exist or has no memory, nodes with memory: %s",
+                policy.node, container_to_string(nodes).c_str()));
+    }
+
+    auto kp = kernel_policy(policy);
+    NodeMask mask(kp.second);
+    if (syscall(SYS_set_mempolicy, kp.first, kp.first == MPOL_DEFAULT ? nullptr : mask.bits, mask.maxnode())) {
+        int err = errno;
+        // without kernel NUMA support there is only one node, so any valid placement is what we'd get anyway
+        if (!(err == ENOSYS && nodes.size() == 1)) {
+            throw std::runtime_error("set_mempolicy failed: " + errno_to_str(err));
+        }
+    }
+    current_policy = policy;
+}
+
+const MemPolicy& get_mem_policy() {
+    return current_policy;
+}
+
+void numa_bind_range(void *start, size_t size) {
+    if (current_policy.mode == MemPolicy::DEFAULT) {
+        return;
+    }
+    auto kp = kernel_policy(current_policy);
+    NodeMask mask(kp.second);
+    if (syscall(SYS_mbind, start, size, kp.first, mask.bits, mask.maxnode(), MPOL_MF_MOVE)) {
+        int err = errno;
+        if (!(err == ENOSYS && numa_memory_nodes().size() == 1)) {
+            throw std::runtime_error("mbind failed: " + errno_to_str(err));
+        }
+    }
+}
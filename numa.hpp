@@ -0,0 +1,65 @@
+/*
+ * numa.hpp
+ *
+ * Minimal NUMA support: discovering the nodes from sysfs and controlling where benchmark memory is placed
+ * (the --mem-node argument). This uses the set_mempolicy and mbind system calls directly, so it doesn't need
+ * libnuma.
+ */
+
+#ifndef NUMA_HPP_
+#define NUMA_HPP_
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+/** the placement policy for benchmark memory */
+struct MemPolicy {
+    enum Mode {
+        /* the kernel default, i.e., usually on the node of the CPU that first touches the memory */
+        DEFAULT,
+        /* bind to a single node */
+        BIND,
+        /* interleave page by page across all nodes with memory */
+        INTERLEAVE
+    };
+
+    Mode mode;
+    /* the node, if mode is BIND */
+    int node;
+
+    /*
+     * Parse the value of the --mem-node argument: either a node number or "interleave". Throws
+     * std::invalid_argument if it is neither.
+     */
+    static MemPolicy parse(const std::string& value);
+
+    /* a description for output, e.g., "node 1" or "nodes [0,1] (interleaved)" */
+    std::string to_string() const;
+};
+
+/** return the online NUMA nodes which have memory, or {0} if the system doesn't expose any NUMA information */
+std::vector<int> numa_memory_nodes();
+
+/** return the NUMA node the given CPU belongs to, or 0 if it can't be determined */
+int numa_node_of_cpu(int cpu);
+
+/**
+ * Set the memory policy for the whole process (with set_mempolicy) and remember it so that the buffers later
+ * allocated by new_huge_ptr() and friends are explicitly bound (with mbind) as well.
+ *
+ * Throws std::runtime_error if the policy can't be applied, except that a kernel without NUMA support is
+ * tolerated when the requested placement is the only node anyway.
+ */
+void set_mem_policy(const MemPolicy& policy);
+
+/** return the policy set by set_mem_policy(), or the default policy if it was never called */
+const MemPolicy& get_mem_policy();
+
+/**
+ * Apply the current memory policy to the given page-aligned range, which should not have been touched yet.
+ * Does nothing under the default policy.
+ */
+void numa_bind_range(void *start, size_t size);
+
+#endif /* NUMA_HPP_ */
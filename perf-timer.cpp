@@ -25,6 +25,7 @@ extern "C" {
 #include "timers.hpp"
 #include "util.hpp"
 #include "context.hpp"
+#include "port-events.hpp"
 
 
 using namespace std;
@@ -51,6 +52,12 @@ struct RunningEvent {
 static int init_count;
 static vector<RunningEvent> running_events;
 
+/* with --ports, the port events, and their resolved attrs split into passes of at most MAX_EXTRA_EVENTS */
+static bool ports_mode;
+static PortEvents port_info;
+static vector<vector<perf_event_attr>> port_pass_attrs;
+static unsigned current_pass;
+
 
 void do_read_events(Context& c) {
     const char* event_file;
@@ -251,11 +258,83 @@ void PerfTimer::init(Context &c) {
         }
     }
 
+    if (args.ports) {
+        init_ports(c, user_only);
+    }
+
     assert(running_events.size() <= PerfNow::READING_COUNT);
 
     for (auto& e : running_events) {
         metric_names_.push_back(e.header);
     }
+    if (ports_mode) {
+        metric_names_.resize(1);
+        metric_names_.insert(metric_names_.end(), port_info.labels.begin(), port_info.labels.end());
+    }
+}
+
+/* replace the events after the cycles event with those of the given --ports pass */
+static void program_pass(unsigned pass) {
+    while (running_events.size() > 1) {
+        rdpmc_close(&running_events.back().ctx);
+        running_events.pop_back();
+    }
+    size_t first = pass * MAX_EXTRA_EVENTS;
+    for (size_t i = 0; i < port_pass_attrs.at(pass).size(); i++) {
+        perf_event_attr attr = port_pass_attrs[pass][i];
+        const string& name = port_info.events.at(first + i);
+        rdpmc_ctx ctx{};
+        if (rdpmc_open_attr(&attr, &ctx, nullptr)) {
+            throw std::runtime_error("failed to program port event " + name + " (" + perf_attr_to_string(&attr) + ")");
+        }
+        if (ctx.buf->index == 0) {
+            rdpmc_close(&ctx);
+            throw std::runtime_error("failed to program port event " + name + " (index == 0, rdpmc not available)");
+        }
+        running_events.emplace_back(ctx, name);
+    }
+    current_pass = pass;
+}
+
+void PerfTimer::init_ports(Context& c, bool user_only) {
+    if (running_events.size() > 1) {
+        c.err() << "--extra-events are ignored with --ports" << endl;
+        while (running_events.size() > 1) {
+            rdpmc_close(&running_events.back().ctx);
+            running_events.pop_back();
+        }
+    }
+
+    port_info = port_events();
+    vector<perf_event_attr> attrs;
+    for (auto& e : port_info.events) {
+        perf_event_attr attr = {};
+        if (resolve_event(e.c_str(), &attr)) {
+            throw std::runtime_error("unable to resolve port event '" + e + "' - check the available events with --list-events");
+        }
+        fixup_event(&attr, user_only);
+        attrs.push_back(attr);
+    }
+    port_pass_attrs = split_passes(attrs, MAX_EXTRA_EVENTS);
+    ports_mode = true;
+    program_pass(0);
+
+    c.out() << "Counting uops per port (" << container_to_string(port_info.events) << ") in "
+            << port_pass_attrs.size() << " passes" << endl;
+}
+
+unsigned PerfTimer::getPassCount() const {
+    return ports_mode ? port_pass_attrs.size() : 1;
+}
+
+void PerfTimer::setPass(unsigned pass) const {
+    if (ports_mode && pass != current_pass) {
+        program_pass(pass);
+    }
+}
+
+std::string PerfTimer::annotate(const TimingResult& result) const {
+    return ports_mode ? port_bottleneck(result, port_info) : std::string();
 }
 
 template <typename E>
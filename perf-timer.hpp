@@ -56,7 +56,17 @@ public:
 
     virtual void listEvents(Context& c) override;
 
+    virtual unsigned getPassCount() const override;
+
+    virtual void setPass(unsigned pass) const override;
+
+    virtual std::string annotate(const TimingResult& result) const override;
+
     virtual ~PerfTimer();
+
+private:
+    /* set up --ports: resolve the port events for this CPU and program those of the first pass */
+    void init_ports(Context& c, bool user_only);
 };
 
 /* parse an --extra-events string of perf events
@@ -0,0 +1,102 @@
+/*
+ * plateaus.hpp
+ *
+ * Helpers to find flat regions ("plateaus") and the knees between them in a series of measurements
+ * taken at increasing values of some parameter, e.g., load latency at increasing memory footprints, and
+ * the change points in a time series.
+ */
+
+#ifndef PLATEAUS_HPP_
+#define PLATEAUS_HPP_
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+#include "stats.hpp"
+
+struct Plateau {
+    /* index of the first and last point (inclusive) in the plateau */
+    size_t first, last;
+    /* the representative value for the plateau (the median of the points it covers) */
+    double level;
+
+    size_t size() const { return last - first + 1; }
+};
+
+/**
+ * Find the plateaus in values, which is a series of measurements at increasing values of some parameter.
+ *
+ * A plateau is a run of at least min_len consecutive points which are all within rel_tol (relative) plus
+ * abs_tol (absolute) of the smallest value in the run. The absolute tolerance is useful for series whose
+ * values may be close to zero, such as the difference between two other series. Points which are not part of
+ * any plateau are transition points and are simply not covered by any returned Plateau. Consecutive plateaus
+ * whose levels are within tolerance of each other (e.g., because a single noisy point split one plateau in two)
+ * are merged.
+ *
+ * The plateaus are returned in order of increasing index.
+ */
+inline std::vector<Plateau> find_plateaus(const std::vector<double>& values, double rel_tol, size_t min_len, double abs_tol = 0) {
+    auto within = [=](double value, double base) { return value <= base * (1 + rel_tol) + abs_tol; };
+    std::vector<Plateau> ret;
+    size_t i = 0;
+    while (i < values.size()) {
+        double run_min = values[i], run_max = values[i];
+        size_t j = i;
+        while (j + 1 < values.size()) {
+            double next = values[j + 1];
+            double new_min = std::min(run_min, next);
+            // every point in the run must stay within the tolerance of the run minimum, including the
+            // earlier points if the minimum drops, i.e., the largest of them
+            if (!within(std::max(run_max, next), new_min)) {
+                break;
+            }
+            run_min = new_min;
+            run_max = std::max(run_max, next);
+            j++;
+        }
+        if (j - i + 1 >= min_len) {
+            double level = Stats::median(values.begin() + i, values.begin() + j + 1);
+            if (!ret.empty() && within(std::max(level, ret.back().level), std::min(level, ret.back().level))) {
+                ret.back().last = j;
+                ret.back().level = Stats::median(values.begin() + ret.back().first, values.begin() + j + 1);
+            } else {
+                ret.push_back({i, j, level});
+            }
+        }
+        i = j + 1;
+    }
+    return ret;
+}
+
+struct ChangePoint {
+    /* index of the first point at the new level */
+    size_t index;
+    /* the levels before and after the change */
+    double before, after;
+};
+
+/**
+ * Find the points where a time series, such as per-sample timings, shifts from one level to another.
+ *
+ * The series is first reduced to the medians of consecutive windows of window points, which hides isolated
+ * outliers such as interrupts, and the change points are then the boundaries between the plateaus (see
+ * find_plateaus) of at least min_windows windows in the medians. The index of a change point is that of the first
+ * point in the first window of the later plateau, so it is only accurate to within the length of the transition
+ * plus one window.
+ */
+inline std::vector<ChangePoint> find_change_points(const std::vector<double>& values, size_t window, double rel_tol,
+        size_t min_windows, double abs_tol = 0) {
+    std::vector<double> medians;
+    for (size_t i = 0; i + window <= values.size(); i += window) {
+        medians.push_back(Stats::median(values.begin() + i, values.begin() + i + window));
+    }
+    auto plateaus = find_plateaus(medians, rel_tol, min_windows, abs_tol);
+    std::vector<ChangePoint> ret;
+    for (size_t i = 1; i < plateaus.size(); i++) {
+        ret.push_back({plateaus[i].first * window, plateaus[i - 1].level, plateaus[i].level});
+    }
+    return ret;
+}
+
+#endif /* PLATEAUS_HPP_ */
@@ -0,0 +1,123 @@
+/*
+ * port-events.cpp
+ */
+
+#include "port-events.hpp"
+#include "util.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+#include <cpuid.h>
+
+/* the display family and model from cpuid leaf 1 */
+static void family_model(unsigned& family, unsigned& model) {
+    unsigned eax, ebx, ecx, edx;
+    __cpuid(1, eax, ebx, ecx, edx);
+    family = (eax >> 8) & 0xF;
+    model  = (eax >> 4) & 0xF;
+    if (family == 0xF) {
+        family += (eax >> 20) & 0xFF;
+    }
+    if (family == 0x6 || family == 0xF) {
+        model += ((eax >> 16) & 0xF) << 4;
+    }
+}
+
+static bool is_intel() {
+    unsigned eax, regs[3];
+    __cpuid(0, eax, regs[0], regs[2], regs[1]);
+    return std::string(reinterpret_cast<const char *>(regs), sizeof(regs)) == "GenuineIntel";
+}
+
+/* a port busy in at least this fraction of cycles is the bottleneck, short of that the limit is elsewhere */
+constexpr double PORT_BOTTLENECK_UTIL = 0.9;
+
+static bool model_in(unsigned model, std::initializer_list<unsigned> models) {
+    return std::find(models.begin(), models.end(), model) != models.end();
+}
+
+/* one event per port, PREFIX0 through PREFIX(count - 1) */
+static PortEvents numbered(const std::string& prefix, unsigned count) {
+    PortEvents ret;
+    for (unsigned p = 0; p < count; p++) {
+        ret.labels.push_back("p" + std::to_string(p));
+        ret.events.push_back(prefix + std::to_string(p));
+        ret.widths.push_back(1);
+    }
+    return ret;
+}
+
+/* events for groups of ports, as on Ice Lake and later: the suffixes are like "2_3" */
+static PortEvents grouped(const std::string& prefix, std::initializer_list<std::string> suffixes) {
+    PortEvents ret;
+    for (auto& s : suffixes) {
+        std::string label = "p";
+        for (char c : s) {
+            if (c != '_') {
+                label += c;
+            }
+        }
+        ret.labels.push_back(label);
+        ret.events.push_back(prefix + s);
+        ret.widths.push_back(std::count(s.begin(), s.end(), '_') + 1);
+    }
+    return ret;
+}
+
+PortEvents port_events() {
+    unsigned family, model;
+    family_model(family, model);
+    if (is_intel() && family == 6) {
+        if (model_in(model, {0x2A, 0x2D, 0x3A, 0x3E})) {
+            // Sandy Bridge, Ivy Bridge
+            return numbered("UOPS_DISPATCHED_PORT.PORT_", 6);
+        }
+        if (model_in(model, {0x3C, 0x3F, 0x45, 0x46, 0x3D, 0x47, 0x4F, 0x56})) {
+            // Haswell, Broadwell
+            return numbered("UOPS_EXECUTED_PORT.PORT_", 8);
+        }
+        if (model_in(model, {0x4E, 0x5E, 0x55, 0x8E, 0x9E, 0xA5, 0xA6})) {
+            // Skylake, Kaby Lake, Coffee Lake, Comet Lake, Skylake-X, Cascade Lake
+            return numbered("UOPS_DISPATCHED_PORT.PORT_", 8);
+        }
+        if (model_in(model, {0x7D, 0x7E, 0x6A, 0x6C, 0x8C, 0x8D, 0xA7})) {
+            // Ice Lake, Tiger Lake, Rocket Lake
+            return grouped("UOPS_DISPATCHED.PORT_", {"0", "1", "2_3", "4_9", "5", "6", "7_8"});
+        }
+        if (model_in(model, {0x8F, 0x97, 0x9A, 0xB7, 0xBA, 0xBF, 0xCF})) {
+            // Sapphire Rapids, Emerald Rapids, Alder Lake and Raptor Lake (P-cores)
+            return grouped("UOPS_DISPATCHED.PORT_", {"0", "1", "2_3_10", "4_9", "5_11", "6", "7_8"});
+        }
+    }
+    throw std::runtime_error(string_format("--ports doesn't know the port events for this CPU (family 0x%x model 0x%x)",
+            family, model));
+}
+
+std::vector<std::string> PortEvents::pfm4_events() const {
+    std::vector<std::string> ret;
+    for (auto e : events) {
+        e[e.find('.')] = ':';
+        ret.push_back(e);
+    }
+    return ret;
+}
+
+std::string port_bottleneck(const TimingResult& result, const PortEvents& ports) {
+    auto& values = result.getResults();
+    if (values.size() != ports.events.size() + 1 || values[0] <= 0) {
+        return {};
+    }
+    double cycles = values[0];
+    size_t busiest = 0;
+    double busiest_util = -1;
+    for (size_t i = 0; i < ports.events.size(); i++) {
+        double util = values[i + 1] / (cycles * ports.widths[i]);
+        if (util > busiest_util) {
+            busiest = i;
+            busiest_util = util;
+        }
+    }
+    return string_format("%s %.0f%%%s", ports.labels[busiest].c_str(), busiest_util * 100,
+            busiest_util >= PORT_BOTTLENECK_UTIL ? " bottleneck" : "");
+}
@@ -0,0 +1,52 @@
+/*
+ * port-events.hpp
+ *
+ * Support for the --ports mode of the PMU timers: the per-port uop events for the current CPU, and the bottleneck
+ * port inferred from the counts.
+ */
+
+#ifndef PORT_EVENTS_HPP_
+#define PORT_EVENTS_HPP_
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "timer-info.hpp"
+
+/* the events counting uops dispatched to each execution port (or group of ports sharing an event) */
+struct PortEvents {
+    /* short labels for the output columns, e.g., "p0" or "p23" */
+    std::vector<std::string> labels;
+    /* the event names, in the jevents (perf) form, e.g., UOPS_DISPATCHED_PORT.PORT_0 */
+    std::vector<std::string> events;
+    /* the number of ports each event covers, i.e., the most uops it can count per cycle */
+    std::vector<unsigned> widths;
+
+    /* the event names in the libpfm4 form, e.g., UOPS_DISPATCHED_PORT:PORT_0 */
+    std::vector<std::string> pfm4_events() const;
+};
+
+/* the port events for the current CPU, throwing if the CPU isn't one we know the port events for */
+PortEvents port_events();
+
+/*
+ * Split the events into passes of at most per_pass events each, since there are usually more ports than
+ * programmable counters.
+ */
+template <typename E>
+std::vector<std::vector<E>> split_passes(const std::vector<E>& events, size_t per_pass) {
+    std::vector<std::vector<E>> passes;
+    for (size_t i = 0; i < events.size(); i += per_pass) {
+        passes.emplace_back(events.begin() + i, events.begin() + std::min(events.size(), i + per_pass));
+    }
+    return passes;
+}
+
+/*
+ * Given a result whose first value is cycles and whose remaining values are the port counts (in the same order as
+ * ports.events, all per op), describe the busiest port and whether it is the bottleneck, e.g., "p1 97% bottleneck".
+ */
+std::string port_bottleneck(const TimingResult& result, const PortEvents& ports);
+
+#endif /* PORT_EVENTS_HPP_ */
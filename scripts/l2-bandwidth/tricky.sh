@@ -1,4 +1,6 @@
 # you should run this script from the base uarch-bench directory
+#
+# The memory/bandwidth-jit group runs the same UNROLLB sweep (for 128 and 256 KiB) in one process, without rebuilds.
 
 set -e
 
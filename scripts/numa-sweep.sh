@@ -0,0 +1,45 @@
+#! /usr/bin/env bash
+set -e
+
+# Runs the given uarch-bench tests (a space separated list of --test-name patterns) once for every
+# (cpu node, memory node) pair, pinning to the first CPU of the CPU node and binding memory with
+# --mem-node. On a single-node machine this is just one run.
+
+# You can override any of these variables from outside to customize the behavior of this script.
+: ${UARCH_BENCH:="./uarch-bench"}
+: ${TESTS:="memory/load-serial/* memory/bandwidth/*"}
+: ${EXTRA_ARGS:=""}
+: ${NODE_DIR:="/sys/devices/system/node"}
+
+# expand a kernel cpu/node list like 0-3,8 into a space separated list
+function expand_list {
+	local range
+	for range in ${1//,/ }; do
+		seq ${range%-*} ${range#*-}
+	done
+}
+
+if [[ -r $NODE_DIR/has_cpu ]]; then
+	cpu_nodes=$(expand_list "$(cat $NODE_DIR/has_cpu)")
+	mem_nodes=$(expand_list "$(cat $NODE_DIR/has_memory)")
+else
+	cpu_nodes=0
+	mem_nodes=0
+fi
+
+# the test patterns contain * which must not be expanded against the filesystem
+set -f
+
+for cpu_node in $cpu_nodes; do
+	if [[ -r $NODE_DIR/node$cpu_node/cpulist ]]; then
+		cpu=$(expand_list "$(cat $NODE_DIR/node$cpu_node/cpulist)" | head -1)
+	else
+		cpu=0
+	fi
+	for mem_node in $mem_nodes; do
+		echo "===== CPU node $cpu_node (CPU $cpu), memory node $mem_node ====="
+		for test in $TESTS; do
+			$UARCH_BENCH --pinned-cpu=$cpu --mem-node=$mem_node --test-name="$test" $EXTRA_ARGS
+		done
+	done
+done
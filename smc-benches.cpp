@@ -0,0 +1,221 @@
+/*
+ * smc-benches.cpp
+ *
+ * The cost of self-modifying code (SMC), where a thread stores to code near what it is running, and of
+ * cross-modifying code, where another thread does. The code is generated by the jit emitter into shared memory with
+ * a second, writable view (see jit::Emitter::finish_aliased): the processor detects stores to code by physical
+ * address, so a store through either view counts.
+ *
+ * The stores are to code about to run (the next instruction), to the rest of the running 64-byte line, to another
+ * line of the same 4 KiB page, to a different page, and for comparison to ordinary data. Add MACHINE_CLEARS.SMC with
+ * --extra-events (perf or libpfc timers) to see the machine clears per patch.
+ */
+
+#include <thread>
+
+#include "benchmark.hpp"
+#include "contended.hpp"
+#include "util.hpp"
+#include "jit.hpp"
+
+using namespace std;
+using namespace jit;
+
+constexpr size_t SMC_PAGE = 4096;
+
+/* the code the stores target */
+enum SmcTarget { SMC_DATA, SMC_NEXT, SMC_LINE, SMC_PAGE_LINE, SMC_FAR };
+
+static const struct {
+    const char *id, *desc;
+} SMC_TARGETS[] = {
+    {"data",      "data"},
+    {"next",      "the next instruction"},
+    {"same-line", "the running line"},
+    {"same-page", "another line in the page"},
+    {"far",       "another page"},
+};
+
+/* the loop body: a store to the target then straight on, a store then a call to the far function, or no store */
+enum SmcKind { SMC_STORE, SMC_STORE_CALL, SMC_RUN };
+
+/* the positions of the targets in code from emit_smc */
+struct SmcLabels {
+    Label next, line, page, far;
+};
+
+/*
+ * A loop of the given kind in the first line of the first page, with rsi pointing to the byte to store to. The
+ * targets are the imm32 of a mov ecx just after the store, the code after the ret (never run), a line in the middle
+ * of the page and a function (a mov ecx with its imm32 and a ret) two pages on, only run by SMC_STORE_CALL.
+ */
+static Emitter emit_smc(SmcKind kind, SmcLabels& labels) {
+    Emitter e;
+    Fixup call = {};
+    loop(e, [&](Emitter& e) {
+        if (kind != SMC_RUN) {
+            e.movb(ptr(RSI), RAX);
+        }
+        if (kind == SMC_STORE_CALL) {
+            call = e.call_forward();
+        } else {
+            labels.next = Label{e.size() + 1};
+            e.mov(RCX, 0u);
+        }
+    });
+    e.ret();
+    labels.line = e.here();
+    e.nop(SMC_PAGE / 2 - e.size());
+    labels.page = e.here();
+    e.nop(2 * SMC_PAGE - e.size());
+    if (kind == SMC_STORE_CALL) {
+        e.bind(call);
+    }
+    labels.far = Label{e.size() + 1};
+    e.mov(RCX, 0u);
+    e.ret();
+    return e;
+}
+
+/* the address to store to for the given target, in the writable view of code */
+static void *smc_address(const Code& code, const SmcLabels& labels, SmcTarget target) {
+    alignas(64) static uint8_t data[64];
+    switch (target) {
+    case SMC_DATA:      return data;
+    case SMC_NEXT:      return code.writable(labels.next);
+    case SMC_LINE:      return code.writable(labels.line);
+    case SMC_PAGE_LINE: return code.writable(labels.page);
+    case SMC_FAR:       return code.writable(labels.far);
+    }
+    assert(false);
+    return nullptr;
+}
+
+/* the code of the given kind, generated once, with its labels */
+struct SmcCode {
+    shared_ptr<Code> code;
+    SmcLabels labels;
+
+    static const SmcCode& get(SmcKind kind) {
+        static SmcCode all[3];
+        SmcCode& c = all[kind];
+        if (!c.code) {
+            c.code = emit_smc(kind, c.labels).finish_aliased();
+        }
+        return c;
+    }
+};
+
+/* the helper's side of the cross-modifying benchmarks: store to the byte at arg, iters times */
+static long patch_loop(uint64_t iters, void *arg) {
+    volatile uint8_t *p = static_cast<volatile uint8_t *>(arg);
+    for (uint64_t i = 0; i < iters; i++) {
+        *p = 0;
+    }
+    return 0;
+}
+
+/*
+ * Cross-modifying code: the main thread runs a loop while a helper thread, pinned to another allowed CPU, stores to
+ * the target over and over. The main thread's cycles per iteration are timed as usual, followed by the helper's
+ * cycles per patch and the patches per main iteration.
+ */
+class CrossModifyGroup : public BenchmarkGroup {
+    /* parallel to getBenches() */
+    vector<SmcTarget> targets_;
+
+public:
+    CrossModifyGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    template <typename TIMER>
+    static shared_ptr<CrossModifyGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<CrossModifyGroup>(id, desc);
+        auto maker = DeltaMaker<TIMER>(group.get(), 1000);
+        for (SmcTarget target : {SMC_DATA, SMC_NEXT, SMC_LINE, SMC_PAGE_LINE, SMC_FAR}) {
+            auto call = make_shared<JitCall>();
+            maker.template make<jit_call>(SMC_TARGETS[target].id,
+                    string("Other thread stores to ") + SMC_TARGETS[target].desc, 1,
+                    [=]{
+                        call->code = SmcCode::get(SMC_RUN).code;
+                        return call.get();
+                    });
+            group->targets_.push_back(target);
+        }
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == targets_.size());
+        vector<int> helpers = helper_cpus(c);
+
+        bool header = false;
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b)) {
+                continue;
+            }
+            if (!header) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                if (helpers.empty()) {
+                    c.out() << "Skipping: needs at least 2 allowed CPUs, but only 1 available" << std::endl;
+                    return;
+                }
+                printGroupHeader(c);
+                header = true;
+            }
+
+            const SmcCode& code = SmcCode::get(SMC_RUN);
+            Contenders state;
+            Contenders::Result helper;
+            std::thread t(Contenders::run, std::ref(state), std::ref(c), helpers.front(), patch_loop, 1,
+                    smc_address(*code.code, code.labels, targets_[i]), std::ref(helper));
+            while (state.ready.load() != 1)
+                ;
+            state.go = true;
+            TimingResult result = b->run(c.getTimerInfo());
+            state.stop = true;
+            t.join();
+
+            printResultLine(c, b, result);
+            double per_patch = helper.nanos * DefaultClockTimer::getGHz() / helper.ops;
+            c.out() << string_format("%40s helper: %.1f cycles per patch, %.2f patches per iteration", "",
+                    per_patch, result.getCycles() / per_patch) << std::endl;
+        }
+
+        if (!header) {
+            return;
+        }
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+};
+
+template <typename TIMER>
+void register_smc(GroupList& list) {
+    std::shared_ptr<BenchmarkGroup> group = std::make_shared<BenchmarkGroup>("smc", "Self-modifying code, per patch");
+    list.push_back(group);
+    auto maker = DeltaMaker<TIMER>(group.get(), 1000);
+
+    auto make = [&](const string& id, const string& desc, SmcKind kind, SmcTarget target) {
+        auto call = make_shared<JitCall>();
+        maker.template make<jit_call>(id, desc, 1, [=]{
+            const SmcCode& code = SmcCode::get(kind);
+            call->code = code.code;
+            call->arg = smc_address(*code.code, code.labels, target);
+            return call.get();
+        });
+    };
+    for (SmcTarget target : {SMC_DATA, SMC_NEXT, SMC_LINE, SMC_PAGE_LINE, SMC_FAR}) {
+        make(SMC_TARGETS[target].id, string("Store to ") + SMC_TARGETS[target].desc, SMC_STORE, target);
+    }
+    // patching a function just before calling it, as a JIT does, against calling it after a store to data
+    make("call-data", "Store to data, then call", SMC_STORE_CALL, SMC_DATA);
+    make("patch-call", "Patch a function, then call it", SMC_STORE_CALL, SMC_FAR);
+
+    list.push_back(CrossModifyGroup::make<TIMER>("smc/cross", "Cross-modifying code, per main thread iteration"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_smc<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
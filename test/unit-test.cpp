@@ -8,10 +8,15 @@
 #include "../matchers.hpp"
 #include "../simple-timer.hpp"
 #include "../perf-timer.hpp"
+#include "../plateaus.hpp"
+#include "../jit.hpp"
+#include "../port-events.hpp"
 
 #include "catch.hpp"
 
 #include <thread>
+#include <functional>
+#include <stdexcept>
 
 
 TEST_CASE( "string_format", "[util]" ) {
@@ -204,6 +209,117 @@ TEST_CASE( "simple_timer", "[util]" ) {
 
 }
 
+TEST_CASE( "find_plateaus", "[util]" ) {
+    using dv = std::vector<double>;
+
+    CHECK(find_plateaus(dv{}, 0.1, 2).empty());
+
+    {
+        // three clean levels with transition points in between
+        auto p = find_plateaus(dv{4, 4, 4.1, 4, 7, 12, 12, 11.9, 12, 25, 40, 41, 40}, 0.1, 2);
+        REQUIRE(p.size() == 3);
+        CHECK(p[0].first ==  0);
+        CHECK(p[0].last  ==  3);
+        CHECK(p[0].level == Approx(4));
+        CHECK(p[1].first ==  5);
+        CHECK(p[1].last  ==  8);
+        CHECK(p[1].level == Approx(12));
+        CHECK(p[2].first == 10);
+        CHECK(p[2].last  == 12);
+        CHECK(p[2].level == Approx(40));
+    }
+
+    {
+        // a single noisy point doesn't split a level
+        auto p = find_plateaus(dv{4, 4, 9, 4, 4, 12, 12}, 0.1, 2);
+        REQUIRE(p.size() == 2);
+        CHECK(p[0].first == 0);
+        CHECK(p[0].last  == 4);
+        CHECK(p[1].first == 5);
+    }
+
+    {
+        // when the minimum drops, an earlier point above the tolerance of the new minimum ends the run
+        auto p = find_plateaus(dv{10, 11.4, 9.5}, 0.15, 2);
+        REQUIRE(p.size() == 1);
+        CHECK(p[0].first == 0);
+        CHECK(p[0].last  == 1);
+    }
+
+    {
+        // a slow ramp has no plateaus if min_len is long enough
+        CHECK(find_plateaus(dv{10, 11, 12.5, 14, 16, 18}, 0.1, 3).empty());
+    }
+
+    SECTION("abs_tol") {
+        // values around zero never satisfy a purely relative tolerance
+        dv values{0.1, -0.2, 0.3, 0, 20, 21, 20};
+        CHECK(find_plateaus(values, 0.1, 3).size() == 1);
+        auto p = find_plateaus(values, 0.1, 3, 1.0);
+        REQUIRE(p.size() == 2);
+        CHECK(p[0].first == 0);
+        CHECK(p[0].last == 3);
+        CHECK(p[1].first == 4);
+    }
+}
+
+TEST_CASE( "find_change_points", "[util]" ) {
+    using dv = std::vector<double>;
+
+    CHECK(find_change_points(dv{}, 4, 0.1, 2).empty());
+
+    // a slow start which steps down to the steady level at index 8, with an outlier in each level
+    dv values{4, 4, 4, 30, 4, 4, 4, 4, 1, 1, 1, 1, 1, 9, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+    auto p = find_change_points(values, 4, 0.1, 2);
+    REQUIRE(p.size() == 1);
+    CHECK(p[0].index == 8);
+    CHECK(p[0].before == Approx(4));
+    CHECK(p[0].after == Approx(1));
+
+    // too short to be a level
+    CHECK(find_change_points(values, 4, 0.1, 3).empty());
+}
+
+TEST_CASE( "parse_cpu_list", "[util]" ) {
+    using iv = std::vector<int>;
+    CHECK(parse_cpu_list("0") == iv{0});
+    CHECK(parse_cpu_list("0-3") == iv{0, 1, 2, 3});
+    CHECK(parse_cpu_list("8,0-1,10-11\n") == iv{0, 1, 8, 10, 11});
+    CHECK(parse_cpu_list("") == iv{});
+    CHECK_THROWS(parse_cpu_list("3-1"));
+    CHECK_THROWS(parse_cpu_list("1-"));
+    CHECK_THROWS(parse_cpu_list("x"));
+}
+
+TEST_CASE( "split_passes", "[util]" ) {
+    using iv = std::vector<int>;
+    auto passes = split_passes(iv{0, 1, 2, 3, 4, 5, 6}, 4);
+    REQUIRE(passes.size() == 2);
+    CHECK(passes[0] == iv{0, 1, 2, 3});
+    CHECK(passes[1] == iv{4, 5, 6});
+    CHECK(split_passes(iv{0, 1, 2, 3}, 4).size() == 1);
+    CHECK(split_passes(iv{}, 4).empty());
+}
+
+TEST_CASE( "port_bottleneck", "[util]" ) {
+    PortEvents ports;
+    ports.labels = {"p0", "p1", "p23", "p5"};
+    ports.events = {"P0", "P1", "P23", "P5"};
+    ports.widths = {1, 1, 2, 1};
+
+    // cycles first, then the port counts: p23 does the most uops but covers two ports, so p1 is busier
+    CHECK(port_bottleneck(TimingResult({10, 5, 8, 12, 2}), ports) == "p1 80%");
+    // p23 at 1.9 uops per cycle over its two ports, past the 90% bottleneck threshold
+    CHECK(port_bottleneck(TimingResult({10, 5, 8, 19, 2}), ports) == "p23 95% bottleneck");
+    CHECK(port_bottleneck(TimingResult({10, 9, 0, 0, 0}), ports) == "p0 90% bottleneck");
+    CHECK(port_bottleneck(TimingResult({10, 8.9, 0, 0, 0}), ports) == "p0 89%");
+
+    // the results of a merged 2-pass run, with a pass missing, or with no cycles
+    CHECK(port_bottleneck(TimingResult({10, 5, 8}), ports).empty());
+    CHECK(port_bottleneck(TimingResult({10, 5, 8, 12, 2, 1}), ports).empty());
+    CHECK(port_bottleneck(TimingResult({0, 5, 8, 12, 2}), ports).empty());
+}
+
 TEST_CASE( "parse_perf_events", "[perf]" ) {
     using sv = std::vector<std::string>;
     CHECK(parsePerfEvents("foo,bar") == sv{"foo", "bar"});
@@ -212,6 +328,244 @@ TEST_CASE( "parse_perf_events", "[perf]" ) {
     CHECK(parsePerfEvents("foo/bar,baz/,beef,blah") == sv{"foo/bar,baz/", "beef", "blah"});
 }
 
+/* the code emitted by f into a fresh jit::Emitter */
+static std::vector<uint8_t> jit_bytes(std::function<void(jit::Emitter&)> f) {
+    jit::Emitter e;
+    f(e);
+    return e.bytes();
+}
+
+TEST_CASE( "jit_encodings", "[jit]" ) {
+    using namespace jit;
+    using bytes = std::vector<uint8_t>;
+    struct Form {
+        const char *nasm;
+        std::function<void(Emitter&)> emit;
+        bytes expected;
+    };
+    // the expected bytes are those NASM assembles for each form
+    const Form forms[] = {
+        // register forms, low and high registers
+        {"mov rax, rcx",                  [](Emitter& e){ e.mov(RAX, RCX); },
+                {0x48, 0x89, 0xC8}},
+        {"mov r9, r15",                   [](Emitter& e){ e.mov(R9, R15); },
+                {0x4D, 0x89, 0xF9}},
+        {"mov eax, 0x12345678",           [](Emitter& e){ e.mov(RAX, 0x12345678u); },
+                {0xB8, 0x78, 0x56, 0x34, 0x12}},
+        {"mov r11d, 1",                   [](Emitter& e){ e.mov(R11, 1u); },
+                {0x41, 0xBB, 0x01, 0x00, 0x00, 0x00}},
+        {"add rdx, r10",                  [](Emitter& e){ e.add(RDX, R10); },
+                {0x4C, 0x01, 0xD2}},
+        {"add rax, byte 1",               [](Emitter& e){ e.add(RAX, 1); },
+                {0x48, 0x83, 0xC0, 0x01}},
+        {"add rax, 128",                  [](Emitter& e){ e.add(RAX, 128); },
+                {0x48, 0x05, 0x80, 0x00, 0x00, 0x00}},
+        {"add rcx, byte -128",            [](Emitter& e){ e.add(RCX, -128); },
+                {0x48, 0x83, 0xC1, 0x80}},
+        {"add r12, 1000",                 [](Emitter& e){ e.add(R12, 1000); },
+                {0x49, 0x81, 0xC4, 0xE8, 0x03, 0x00, 0x00}},
+        {"sub rsp, byte 8",               [](Emitter& e){ e.sub(RSP, 8); },
+                {0x48, 0x83, 0xEC, 0x08}},
+        {"sub rax, 4096",                 [](Emitter& e){ e.sub(RAX, 4096); },
+                {0x48, 0x2D, 0x00, 0x10, 0x00, 0x00}},
+        {"imul rax, r8",                  [](Emitter& e){ e.imul(RAX, R8); },
+                {0x49, 0x0F, 0xAF, 0xC0}},
+        {"imul r13, rbx",                 [](Emitter& e){ e.imul(R13, RBX); },
+                {0x4C, 0x0F, 0xAF, 0xEB}},
+        {"xor eax, eax",                  [](Emitter& e){ e.xor_(RAX, RAX); },
+                {0x31, 0xC0}},
+        {"xor r14d, r14d",                [](Emitter& e){ e.xor_(R14, R14); },
+                {0x45, 0x31, 0xF6}},
+        {"cmp rcx, r9",                   [](Emitter& e){ e.cmp(RCX, R9); },
+                {0x4C, 0x39, 0xC9}},
+        {"test r10, rax",                 [](Emitter& e){ e.test(R10, RAX); },
+                {0x49, 0x85, 0xC2}},
+        {"cmovae rax, r11",               [](Emitter& e){ e.cmovae(RAX, R11); },
+                {0x49, 0x0F, 0x43, 0xC3}},
+        {"cmovae r8, rdx",                [](Emitter& e){ e.cmovae(R8, RDX); },
+                {0x4C, 0x0F, 0x43, 0xC2}},
+        {"dec rdi",                       [](Emitter& e){ e.dec(RDI); },
+                {0x48, 0xFF, 0xCF}},
+        {"dec r15",                       [](Emitter& e){ e.dec(R15); },
+                {0x49, 0xFF, 0xCF}},
+        {"push rbx",                      [](Emitter& e){ e.push(RBX); },
+                {0x53}},
+        {"push r12",                      [](Emitter& e){ e.push(R12); },
+                {0x41, 0x54}},
+        {"pop r15",                       [](Emitter& e){ e.pop(R15); },
+                {0x41, 0x5F}},
+        {"jmp rax",                       [](Emitter& e){ e.jmp(RAX); },
+                {0xFF, 0xE0}},
+        {"jmp r11",                       [](Emitter& e){ e.jmp(R11); },
+                {0x41, 0xFF, 0xE3}},
+        {"lfence",                        [](Emitter& e){ e.lfence(); },
+                {0x0F, 0xAE, 0xE8}},
+        {"ud2",                           [](Emitter& e){ e.ud2(); },
+                {0x0F, 0x0B}},
+        {"ret",                           [](Emitter& e){ e.ret(); },
+                {0xC3}},
+
+        // memory operands: rsp and r12 bases need a SIB byte, rbp and r13 have no disp-less form, disp8/disp32
+        {"mov rax, [rcx]",                [](Emitter& e){ e.mov(RAX, ptr(RCX)); },
+                {0x48, 0x8B, 0x01}},
+        {"mov rax, [rsp]",                [](Emitter& e){ e.mov(RAX, ptr(RSP)); },
+                {0x48, 0x8B, 0x04, 0x24}},
+        {"mov rax, [r12]",                [](Emitter& e){ e.mov(RAX, ptr(R12)); },
+                {0x49, 0x8B, 0x04, 0x24}},
+        {"mov rax, [rbp]",                [](Emitter& e){ e.mov(RAX, ptr(RBP)); },
+                {0x48, 0x8B, 0x45, 0x00}},
+        {"mov rax, [r13]",                [](Emitter& e){ e.mov(RAX, ptr(R13)); },
+                {0x49, 0x8B, 0x45, 0x00}},
+        {"mov r9, [rsi + 127]",           [](Emitter& e){ e.mov(R9, ptr(RSI, 127)); },
+                {0x4C, 0x8B, 0x4E, 0x7F}},
+        {"mov r9, [rsi + 128]",           [](Emitter& e){ e.mov(R9, ptr(RSI, 128)); },
+                {0x4C, 0x8B, 0x8E, 0x80, 0x00, 0x00, 0x00}},
+        {"mov rdx, [r12 - 128]",          [](Emitter& e){ e.mov(RDX, ptr(R12, -128)); },
+                {0x49, 0x8B, 0x54, 0x24, 0x80}},
+        {"mov rdx, [r13 - 129]",          [](Emitter& e){ e.mov(RDX, ptr(R13, -129)); },
+                {0x49, 0x8B, 0x95, 0x7F, 0xFF, 0xFF, 0xFF}},
+        {"mov [rdx], rax",                [](Emitter& e){ e.mov(ptr(RDX), RAX); },
+                {0x48, 0x89, 0x02}},
+        {"mov [r8 + 8], r15",             [](Emitter& e){ e.mov(ptr(R8, 8), R15); },
+                {0x4D, 0x89, 0x78, 0x08}},
+        {"movzx eax, byte [rcx]",         [](Emitter& e){ e.movzxb(RAX, ptr(RCX)); },
+                {0x0F, 0xB6, 0x01}},
+        {"movzx r10d, byte [r12 + 1]",    [](Emitter& e){ e.movzxb(R10, ptr(R12, 1)); },
+                {0x45, 0x0F, 0xB6, 0x54, 0x24, 0x01}},
+        {"movzx eax, word [rcx]",         [](Emitter& e){ e.movzxw(RAX, ptr(RCX)); },
+                {0x0F, 0xB7, 0x01}},
+        {"movzx r9d, word [r8 + 8]",      [](Emitter& e){ e.movzxw(R9, ptr(R8, 8)); },
+                {0x45, 0x0F, 0xB7, 0x48, 0x08}},
+        {"mov eax, [rcx]",                [](Emitter& e){ e.movl(RAX, ptr(RCX)); },
+                {0x8B, 0x01}},
+        {"mov r10d, [rsp + 300]",         [](Emitter& e){ e.movl(R10, ptr(RSP, 300)); },
+                {0x44, 0x8B, 0x94, 0x24, 0x2C, 0x01, 0x00, 0x00}},
+        {"mov [rdx], al",                 [](Emitter& e){ e.movb(ptr(RDX), RAX); },
+                {0x88, 0x02}},
+        {"mov [rdx], sil",                [](Emitter& e){ e.movb(ptr(RDX), RSI); },
+                {0x40, 0x88, 0x32}},
+        {"mov [r13], r9b",                [](Emitter& e){ e.movb(ptr(R13), R9); },
+                {0x45, 0x88, 0x4D, 0x00}},
+        {"mov [rdx], ax",                 [](Emitter& e){ e.movw(ptr(RDX), RAX); },
+                {0x66, 0x89, 0x02}},
+        {"mov [r8 - 4], si",              [](Emitter& e){ e.movw(ptr(R8, -4), RSI); },
+                {0x66, 0x41, 0x89, 0x70, 0xFC}},
+        {"mov [rdx], eax",                [](Emitter& e){ e.movl(ptr(RDX), RAX); },
+                {0x89, 0x02}},
+        {"mov [r13], r9d",                [](Emitter& e){ e.movl(ptr(R13), R9); },
+                {0x45, 0x89, 0x4D, 0x00}},
+        {"jmp [rax + 8]",                 [](Emitter& e){ e.jmp(ptr(RAX, 8)); },
+                {0xFF, 0x60, 0x08}},
+        {"jmp [r12]",                     [](Emitter& e){ e.jmp(ptr(R12)); },
+                {0x41, 0xFF, 0x24, 0x24}},
+        {"call [rsi]",                    [](Emitter& e){ e.call(ptr(RSI)); },
+                {0xFF, 0x16}},
+        {"call [r13 + 16]",               [](Emitter& e){ e.call(ptr(R13, 16)); },
+                {0x41, 0xFF, 0x55, 0x10}},
+
+        // VEX: the 2-byte form unless the base or rm is r8-r15 or W is set
+        {"vpxor ymm0, ymm0, ymm0",        [](Emitter& e){ e.vpxor(Vec{0}, Vec{0}, Vec{0}); },
+                {0xC5, 0xFD, 0xEF, 0xC0}},
+        {"vpxor ymm9, ymm3, ymm12",       [](Emitter& e){ e.vpxor(Vec{9}, Vec{3}, Vec{12}); },
+                {0xC4, 0x41, 0x65, 0xEF, 0xCC}},
+        {"vpaddb ymm1, ymm2, [rsi + 64]", [](Emitter& e){ e.vpaddb(Vec{1}, Vec{2}, ptr(RSI, 64)); },
+                {0xC5, 0xED, 0xFC, 0x4E, 0x40}},
+        {"vpaddb ymm10, ymm10, [r9]",     [](Emitter& e){ e.vpaddb(Vec{10}, Vec{10}, ptr(R9)); },
+                {0xC4, 0x41, 0x2D, 0xFC, 0x11}},
+        {"vmovdqu xmm0, [rcx]",           [](Emitter& e){ e.vmovdqu(Vec{0}, ptr(RCX), 128); },
+                {0xC5, 0xFA, 0x6F, 0x01}},
+        {"vmovdqu [rdx], xmm0",           [](Emitter& e){ e.vmovdqu(ptr(RDX), Vec{0}, 128); },
+                {0xC5, 0xFA, 0x7F, 0x02}},
+        {"vmovdqu ymm1, [rsi + 64]",      [](Emitter& e){ e.vmovdqu(Vec{1}, ptr(RSI, 64)); },
+                {0xC5, 0xFE, 0x6F, 0x4E, 0x40}},
+        {"vmovdqu [rdx + 32], ymm9",      [](Emitter& e){ e.vmovdqu(ptr(RDX, 32), Vec{9}); },
+                {0xC5, 0x7E, 0x7F, 0x4A, 0x20}},
+        {"vmovdqu ymm4, [r12 + 200]",     [](Emitter& e){ e.vmovdqu(Vec{4}, ptr(R12, 200)); },
+                {0xC4, 0xC1, 0x7E, 0x6F, 0xA4, 0x24, 0xC8, 0x00, 0x00, 0x00}},
+        {"vmovq rax, xmm0",               [](Emitter& e){ e.vmovq(RAX, Vec{0}); },
+                {0xC4, 0xE1, 0xF9, 0x7E, 0xC0}},
+        {"vmovq xmm0, rax",               [](Emitter& e){ e.vmovq(Vec{0}, RAX); },
+                {0xC4, 0xE1, 0xF9, 0x6E, 0xC0}},
+        {"vmovq r9, xmm10",               [](Emitter& e){ e.vmovq(R9, Vec{10}); },
+                {0xC4, 0x41, 0xF9, 0x7E, 0xD1}},
+        {"vmovq xmm11, r12",              [](Emitter& e){ e.vmovq(Vec{11}, R12); },
+                {0xC4, 0x41, 0xF9, 0x6E, 0xDC}},
+        {"vzeroupper",                    [](Emitter& e){ e.vzeroupper(); },
+                {0xC5, 0xF8, 0x77}},
+
+        // EVEX: zmm16-31, and disp8 scaled by the 64-byte operand size
+        {"vmovdqu64 zmm0, [rcx]",         [](Emitter& e){ e.vmovdqu(Vec{0}, ptr(RCX), 512); },
+                {0x62, 0xF1, 0xFE, 0x48, 0x6F, 0x01}},
+        {"vmovdqu64 [rdx], zmm0",         [](Emitter& e){ e.vmovdqu(ptr(RDX), Vec{0}, 512); },
+                {0x62, 0xF1, 0xFE, 0x48, 0x7F, 0x02}},
+        {"vmovdqu64 zmm12, [rbp]",        [](Emitter& e){ e.vmovdqu(Vec{12}, ptr(RBP), 512); },
+                {0x62, 0x71, 0xFE, 0x48, 0x6F, 0x65, 0x00}},
+        {"vmovdqu64 [rdx + 128], zmm17",  [](Emitter& e){ e.vmovdqu(ptr(RDX, 128), Vec{17}, 512); },
+                {0x62, 0xE1, 0xFE, 0x48, 0x7F, 0x4A, 0x02}},
+        {"vmovdqu64 zmm31, [r13 + 8128]", [](Emitter& e){ e.vmovdqu(Vec{31}, ptr(R13, 8128), 512); },
+                {0x62, 0x41, 0xFE, 0x48, 0x6F, 0x7D, 0x7F}},
+        {"vmovdqu64 zmm24, [r12 + 8192]", [](Emitter& e){ e.vmovdqu(Vec{24}, ptr(R12, 8192), 512); },
+                {0x62, 0x41, 0xFE, 0x48, 0x6F, 0x84, 0x24, 0x00, 0x20, 0x00, 0x00}},
+        {"vmovdqu64 zmm3, [r9 + 100]",    [](Emitter& e){ e.vmovdqu(Vec{3}, ptr(R9, 100), 512); },
+                {0x62, 0xD1, 0xFE, 0x48, 0x6F, 0x99, 0x64, 0x00, 0x00, 0x00}},
+        {"vmovdqu64 zmm16, [rsp - 64]",   [](Emitter& e){ e.vmovdqu(Vec{16}, ptr(RSP, -64), 512); },
+                {0x62, 0xE1, 0xFE, 0x48, 0x6F, 0x44, 0x24, 0xFF}},
+    };
+    for (auto& f : forms) {
+        INFO(f.nasm);
+        CHECK(jit_bytes(f.emit) == f.expected);
+    }
+}
+
+TEST_CASE( "jit_labels", "[jit]" ) {
+    using namespace jit;
+    using bytes = std::vector<uint8_t>;
+    auto tail = [](const bytes& b, size_t n) { return bytes(b.end() - n, b.end()); };
+    auto head = [](const bytes& b, size_t n) { return bytes(b.begin(), b.begin() + n); };
+
+    // backward jumps: rel8 while it reaches, otherwise rel32
+    CHECK(jit_bytes([](Emitter& e){ Label top = e.here(); e.nop(); e.jnz(top); }) == bytes{0x90, 0x75, 0xFD});
+    CHECK(jit_bytes([](Emitter& e){ Label top = e.here(); e.nop(); e.jge(top).jb(top); })
+            == bytes{0x90, 0x7D, 0xFD, 0x72, 0xFB});
+    CHECK(jit_bytes([](Emitter& e){ Label top = e.here(); e.jmp(top); }) == bytes{0xEB, 0xFE});
+    auto b = jit_bytes([](Emitter& e){ Label top = e.here(); e.nop(126); e.jnz(top); });
+    CHECK(b.size() == 128);
+    CHECK(tail(b, 2) == bytes{0x75, 0x80});
+    b = jit_bytes([](Emitter& e){ Label top = e.here(); e.nop(127); e.jnz(top); });
+    CHECK(b.size() == 133);
+    CHECK(tail(b, 6) == bytes{0x0F, 0x85, 0x7B, 0xFF, 0xFF, 0xFF});
+    b = jit_bytes([](Emitter& e){ Label top = e.here(); e.nop(200); e.jmp(top); });
+    CHECK(tail(b, 5) == bytes{0xE9, 0x33, 0xFF, 0xFF, 0xFF});
+    CHECK(jit_bytes([](Emitter& e){ Label f = e.here(); e.ret(); e.call(f); })
+            == bytes{0xC3, 0xE8, 0xFA, 0xFF, 0xFF, 0xFF});
+    b = jit_bytes([](Emitter& e){ Label d = e.here(); e.nop(4); e.lea(R9, d); });
+    CHECK(tail(b, 7) == bytes{0x4C, 0x8D, 0x0D, 0xF5, 0xFF, 0xFF, 0xFF});
+
+    // forward jumps, calls and leas, patched by bind()
+    CHECK(jit_bytes([](Emitter& e){ e.bind(e.jz_forward()).nop(); }) == bytes{0x74, 0x00, 0x90});
+    b = jit_bytes([](Emitter& e){ Fixup j = e.jmp_forward(); e.nop(127); e.bind(j); });
+    CHECK(head(b, 2) == bytes{0xEB, 0x7F});
+    b = jit_bytes([](Emitter& e){ Fixup j = e.jnz_forward(false); e.nop(200); e.bind(j); });
+    CHECK(head(b, 6) == bytes{0x0F, 0x85, 0xC8, 0x00, 0x00, 0x00});
+    CHECK(jit_bytes([](Emitter& e){ Fixup j = e.jmp_forward(false); e.ud2(); e.bind(j); })
+            == bytes{0xE9, 0x02, 0x00, 0x00, 0x00, 0x0F, 0x0B});
+    CHECK(jit_bytes([](Emitter& e){ Fixup c = e.call_forward(); e.ud2(); e.bind(c); })
+            == bytes{0xE8, 0x02, 0x00, 0x00, 0x00, 0x0F, 0x0B});
+    CHECK(jit_bytes([](Emitter& e){ Fixup l = e.lea_forward(RAX); e.nop(); e.bind(l); })
+            == bytes{0x48, 0x8D, 0x05, 0x01, 0x00, 0x00, 0x00, 0x90});
+
+    // a short forward jump which doesn't reach
+    Emitter e;
+    Fixup j = e.jmp_forward();
+    e.nop(128);
+    CHECK_THROWS_AS(e.bind(j), std::logic_error);
+
+    // the multi-byte nops, longest first
+    CHECK(jit_bytes([](Emitter& e){ e.nop(3); }) == bytes{0x0F, 0x1F, 0x00});
+    CHECK(jit_bytes([](Emitter& e){ e.nop(11); })
+            == bytes{0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x66, 0x90});
+}
+
 
 
 
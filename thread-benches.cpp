@@ -0,0 +1,283 @@
+/*
+ * thread-benches.cpp
+ *
+ * Benchmarks involving more than one thread, such as bouncing a cache line between two cores or several
+ * threads writing to the same line.
+ *
+ * Only the main (measuring) thread is timed, so timers which count events only for the calling thread (perf)
+ * or only on the pinned core (libpfc) only see the main thread's side of the interaction.
+ */
+
+#include <atomic>
+#include <thread>
+#include <fstream>
+
+#include "benchmark.hpp"
+#include "context.hpp"
+#include "util.hpp"
+#include "table.hpp"
+#include "stats.hpp"
+#include "simple-timer.hpp"
+#include "contended.hpp"
+
+using namespace std;
+
+/*
+ * The shared state for a ping-pong: the flag is bounced between the main thread, which makes it odd, and the
+ * responder thread, which makes it even again. Both fields are on their own line, so only the flag bounces.
+ */
+struct PingPong {
+    alignas(64) std::atomic<uint64_t> flag;
+    alignas(64) std::atomic<bool> stop;
+};
+
+static PingPong pingpong_state;
+
+/* hand off the flag to the other thread using a plain store, and wait with plain loads */
+long pingpong_store(uint64_t iters, void *arg) {
+    PingPong& pp = *static_cast<PingPong*>(arg);
+    uint64_t v = pp.flag.load(std::memory_order_relaxed);
+    while (iters-- > 0) {
+        pp.flag.store(v + 1, std::memory_order_release);
+        while (pp.flag.load(std::memory_order_acquire) != v + 2)
+            ;
+        v += 2;
+    }
+    return 0;
+}
+
+/* hand off the flag to the other thread using a locked RMW (lock xadd), and wait with plain loads */
+long pingpong_rmw(uint64_t iters, void *arg) {
+    PingPong& pp = *static_cast<PingPong*>(arg);
+    uint64_t v = pp.flag.load(std::memory_order_relaxed);
+    while (iters-- > 0) {
+        pp.flag.fetch_add(1, std::memory_order_acq_rel);
+        while (pp.flag.load(std::memory_order_acquire) != v + 2)
+            ;
+        v += 2;
+    }
+    return 0;
+}
+
+/* the other side of the ping-pong: respond to each odd value of the flag until stop is set */
+static void pingpong_responder(Context& c, PingPong& pp, int cpu, bool rmw) {
+    pinToThread(c, cpu, false);
+    // the flag is even when idle, but the main thread may already have made its first handoff
+    uint64_t expect = pp.flag.load(std::memory_order_relaxed) | 1;
+    while (true) {
+        while (pp.flag.load(std::memory_order_acquire) != expect) {
+            if (pp.stop.load(std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        if (rmw) {
+            pp.flag.fetch_add(1, std::memory_order_acq_rel);
+        } else {
+            pp.flag.store(expect + 1, std::memory_order_release);
+        }
+        expect += 2;
+    }
+}
+
+/* read the first line of the given file, or return the empty string if it can't be read */
+static string read_line(const string& path) {
+    std::ifstream f(path);
+    string line;
+    std::getline(f, line);
+    return line;
+}
+
+/* the relationship between two CPUs, from closest to furthest */
+enum CpuRelation {
+    SMT_SIBLING,
+    SHARED_L3,
+    SAME_DIE,
+    CROSS_DIE,
+    CROSS_SOCKET,
+    RELATION_COUNT
+};
+
+static const char* relation_names[RELATION_COUNT] = {
+    "SMT sibling", "Shared L3 (same CCX)", "Same die, other L3", "Cross die", "Cross socket"
+};
+
+/* the topology of one CPU, as reported in sysfs */
+struct CpuTopo {
+    string package, die, core;
+    /* the CPUs sharing the last level of cache with this one, empty if not found */
+    vector<int> l3_shared;
+
+    static CpuTopo read(int cpu) {
+        string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        CpuTopo t;
+        t.package = read_line(base + "/topology/physical_package_id");
+        t.die     = read_line(base + "/topology/die_id");
+        t.core    = read_line(base + "/topology/core_id");
+        for (int index = 0; index < 8; index++) {
+            string cache = base + "/cache/index" + std::to_string(index);
+            if (read_line(cache + "/level") == "3") {
+                try {
+                    t.l3_shared = parse_cpu_list(read_line(cache + "/shared_cpu_list"));
+                } catch (std::invalid_argument&) {}
+            }
+        }
+        return t;
+    }
+
+    CpuRelation relationTo(int other_cpu, const CpuTopo& other) const {
+        if (package != other.package) {
+            return CROSS_SOCKET;
+        }
+        if (die != other.die) {
+            return CROSS_DIE;
+        }
+        if (core == other.core) {
+            return SMT_SIBLING;
+        }
+        if (std::binary_search(l3_shared.begin(), l3_shared.end(), other_cpu)) {
+            return SHARED_L3;
+        }
+        return SAME_DIE;
+    }
+};
+
+/*
+ * Runs each ping-pong benchmark for every ordered pair of allowed CPUs, with the main (timed) thread on the
+ * first CPU and the responder on the second, then prints the NxN matrix of round-trip times and a summary by
+ * the topological relationship between the CPUs.
+ */
+class PingPongGroup : public BenchmarkGroup {
+public:
+    PingPongGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        bool first = true;
+        for (auto& b : getBenches()) {
+            if (!predicate(b)) {
+                continue;
+            }
+            if (first) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                first = false;
+            }
+            runMatrix(c, b);
+        }
+    }
+
+    void runMatrix(Context& c, const Benchmark& b) {
+        SimpleTimer timer;
+        const vector<int>& cpus = c.getAllowedCpus();
+        if (cpus.size() < 2) {
+            c.out() << "Skipping " << b->getPath() << ": needs at least 2 allowed CPUs, but only " << cpus.size() << " available" << endl;
+            return;
+        }
+        bool rmw = b->getId() == "lock-xadd";
+
+        vector<CpuTopo> topos;
+        for (int cpu : cpus) {
+            topos.push_back(CpuTopo::read(cpu));
+        }
+
+        size_t n = cpus.size();
+        vector<vector<double>> cycles(n, vector<double>(n));
+        for (size_t i = 0; i < n; i++) {
+            pinToThread(c, cpus[i], false);
+            for (size_t j = 0; j < n; j++) {
+                if (i == j) {
+                    continue;
+                }
+                pingpong_state.stop = false;
+                std::thread responder(pingpong_responder, std::ref(c), std::ref(pingpong_state), cpus[j], rmw);
+                TimingResult result = b->run(c.getTimerInfo());
+                pingpong_state.stop = true;
+                responder.join();
+                cycles[i][j] = result.getCycles();
+            }
+        }
+        pinToThread(c, c.getPinnedCpu(), false);
+
+        using namespace table;
+        Table t;
+        auto& header = t.newRow().add("from\\to");
+        for (int cpu : cpus) {
+            header.add(cpu);
+        }
+        vector<vector<double>> by_relation(RELATION_COUNT);
+        for (size_t i = 0; i < n; i++) {
+            auto& row = t.newRow().add(cpus[i]);
+            for (size_t j = 0; j < n; j++) {
+                if (i == j) {
+                    row.add("-");
+                } else {
+                    row.add(string_format("%.0f", cycles[i][j]));
+                    by_relation[topos[i].relationTo(cpus[j], topos[j])].push_back(cycles[i][j]);
+                }
+            }
+        }
+        c.out() << endl << b->getDescription() << ", round-trip cycles:" << endl << t.str();
+
+        Table summary;
+        summary.newRow().add("Relationship").add("Pairs").add("Min").add("Median").add("Max");
+        for (int r = 0; r < RELATION_COUNT; r++) {
+            auto& v = by_relation[r];
+            if (v.empty()) {
+                continue;
+            }
+            summary.newRow()
+                    .add(relation_names[r])
+                    .add(v.size())
+                    .add(string_format("%.1f", *std::min_element(v.begin(), v.end())))
+                    .add(string_format("%.1f", Stats::median(v.begin(), v.end())))
+                    .add(string_format("%.1f", *std::max_element(v.begin(), v.end())));
+        }
+        c.out() << endl << "Round-trip cycles by CPU relationship:" << endl << summary.str();
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << b->getPath() << ")" << endl;
+    }
+};
+
+/* the largest spacing between the per-thread counters in the false sharing benchmarks */
+constexpr size_t MAX_COUNTER_SPACING = 128;
+
+/* plain (non-atomic) increments of the counter pointed to by arg */
+long counter_inc(uint64_t iters, void *arg) {
+    volatile uint64_t* counter = static_cast<volatile uint64_t*>(arg);
+    while (iters-- > 0) {
+        *counter = *counter + 1;
+    }
+    return 0;
+}
+
+/* the storage for the false sharing counters, enough for every CPU at the maximum spacing */
+static char* sharing_counters() {
+    static char* storage = static_cast<char*>(aligned_ptr(MAX_COUNTER_SPACING, MAX_COUNTER_SPACING * CPU_SETSIZE));
+    return storage;
+}
+
+template <typename TIMER>
+void register_thread(GroupList& list) {
+    auto group = std::make_shared<PingPongGroup>("threads/ping-pong", "Cache line ping-pong between each pair of CPUs");
+    list.push_back(group);
+
+    auto arg = [](){ return &pingpong_state; };
+    auto maker = DeltaMaker<TIMER>(group.get(), 1000).setTags({"slow"});
+    maker.template make<pingpong_store>("store-load", "Store/load flag handoff", 1, arg);
+    maker.template make<pingpong_rmw>  ("lock-xadd",  "lock xadd flag handoff",  1, arg);
+
+    // Each thread increments its own counter, thread i's counter being i * spacing bytes after the start of a
+    // 128-byte aligned block. So a spacing of 0 is true sharing of a single counter, 8 and 32 are false sharing,
+    // 64 puts each pair of threads in the same 128-byte pair of lines fetched together by the adjacent-line
+    // prefetcher, and 128 fully separates them.
+    auto sharing = std::make_shared<ContendedGroup>("threads/false-sharing", "Per-thread counters at varying spacing");
+    list.push_back(sharing);
+
+    auto sharing_maker = DeltaMaker<TIMER>(sharing.get(), 10 * 1000).setTags({"slow"});
+    for (size_t spacing : {0, 8, 32, 64, 128}) {
+        sharing->add<counter_inc>(sharing_maker, string_format("spacing-%zu", spacing),
+                string_format("Counters %zu bytes apart", spacing), 1,
+                [=](size_t thread){ return sharing_counters() + thread * spacing; });
+    }
+}
+
+#define REG_DEFAULT(CLOCK) template void register_thread<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -0,0 +1,36 @@
+/*
+ * timeline-benches.cpp
+ *
+ * Timeline benchmarks (see timeline.hpp) for the transitions around wide vector code: the warm-up of the upper
+ * lanes and the frequency licence changes, including their effect on scalar code which follows a little AVX-512.
+ */
+
+#include "timeline.hpp"
+#include "isa-support.hpp"
+
+extern "C" {
+bench2_f dep_add_rax_rax;
+bench2_f vz_samereg;
+bench2_f vz256_samereg;
+}
+
+template <typename TIMER>
+void register_timeline(GroupList& list) {
+    std::shared_ptr<BenchmarkGroup> group = std::make_shared<TimelineGroup>("timeline/avx",
+            "Wide vector transitions over time");
+    list.push_back(group);
+
+    // each sample is ~1000 ops: short enough to resolve transitions of a few microseconds
+    auto maker = TimelineMaker<TIMER>(group.get(), 10);
+    auto scalar = maker.setLoopCount(8);
+
+    scalar.template make<dep_add_rax_rax>("scalar-add", "add rax, rax chain", 128);
+    scalar.setFeatures({AVX512F}).template withWarm<vz_samereg>().template make<dep_add_rax_rax>(
+            "scalar-after-avx512", "add rax, rax chain after a few vpaddq zmm", 128);
+    maker.setFeatures({AVX2}).template make<vz256_samereg>("avx256-add", "vpaddq ymm0, ymm0, ymm0 chain", 100);
+    maker.setFeatures({AVX512F}).template make<vz_samereg>("avx512-add", "vpaddq zmm0, zmm0, zmm0 chain", 100);
+}
+
+#define REG_DEFAULT(CLOCK) template void register_timeline<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
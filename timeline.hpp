@@ -0,0 +1,269 @@
+/*
+ * timeline.hpp
+ *
+ * "Timeline" benchmarks run a short kernel back-to-back for a fixed duration (--timeline-ms) and keep every sample,
+ * with its timestamp, to show transitions which play out over microseconds to milliseconds after some code starts
+ * running: e.g., the warm-up of the upper lanes of the vector units once 256 or 512-bit instructions appear, or the
+ * change in frequency licence that follows them. Oneshot benchmarks show the first few samples of cold code, this
+ * shows what happens next.
+ *
+ * Each sample records its start (as TSC ticks since the start of the run), the reference cycles (TSC ticks) it took
+ * and the timer delta, i.e., the core cycles and any --extra-events with the perf or libpfc timers. Samples go into
+ * a buffer allocated before the run so nothing allocates while sampling: if it fills up the run stops early, keeping
+ * the start of the run, where the transitions are. The series is summarized over time slices which double in
+ * length, followed by the change points found in each metric, and with --timeline-dir the full series is also
+ * written as CSV. The benchmarks are skipped when the timer needs several passes for its events (--ports).
+ */
+
+#ifndef TIMELINE_HPP_
+#define TIMELINE_HPP_
+
+#include <fstream>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+
+#include <x86intrin.h>
+
+#include "benchmark.hpp"
+#include "context.hpp"
+#include "plateaus.hpp"
+#include "table.hpp"
+#include "util.hpp"
+
+/* the most samples kept per benchmark: the run stops early once it has this many */
+constexpr size_t TIMELINE_CAPACITY = 1 << 18;
+/* samples taken between checks of the clock for the end of the run */
+constexpr int TIMELINE_CHECK_EVERY = 16;
+/* idle time before each run, so that the effects of earlier benchmarks (e.g., a lower frequency licence) wear off */
+constexpr int TIMELINE_SETTLE_MS = 20;
+/* the length of the first time slice in the summary in microseconds, each later slice is twice the previous one */
+constexpr double TIMELINE_FIRST_SLICE_US = 1;
+/* change point detection: samples per window, windows per level and the relative and absolute tolerances */
+constexpr size_t TIMELINE_WINDOW = 16;
+constexpr size_t TIMELINE_MIN_WINDOWS = 4;
+constexpr double TIMELINE_CHANGE_TOL = 0.1;
+constexpr double TIMELINE_CHANGE_ABS = 0.05;
+
+class TimelineGroup : public BenchmarkGroup {
+public:
+    TimelineGroup(const std::string& id, const std::string& desc) : BenchmarkGroup(id, desc) {}
+
+    virtual void printGroupHeader(Context& c) override {}
+};
+
+template <typename TIMER>
+class TimelineBench : public BenchmarkBase {
+    using delta_t = typename TIMER::delta_t;
+
+    struct Sample {
+        /* TSC at the start of the sample, relative to the start of the run */
+        uint64_t start;
+        /* reference cycles (TSC ticks) taken by the sample */
+        uint64_t ref_cycles;
+        delta_t delta;
+    };
+
+    uint32_t loop_count;
+    bench2_f* method;
+    bench2_f* warm_once;
+    arg_provider_t arg_provider;
+
+public:
+
+    TimelineBench(BenchArgs args, uint32_t loop_count, bench2_f* method, bench2_f* warm_once,
+            arg_provider_t arg_provider) :
+                BenchmarkBase(std::move(args)),
+                loop_count{loop_count},
+                method{method},
+                warm_once{warm_once},
+                arg_provider{std::move(arg_provider)}
+                {}
+
+    virtual TimingResult run(const TimerInfo& ti) override {
+        throw std::logic_error("timeline doesn't do run()");
+    }
+
+    virtual void runAndPrintInner(Context& c) override {
+        // each sample is a single run of the kernel, so it can only count the events of one pass
+        if (c.getTimerInfo().getPassCount() > 1) {
+            c.out() << getPath() << ": skipped, timeline benchmarks can't count events over several passes"
+                    " (e.g., --ports)" << std::endl;
+            return;
+        }
+        std::vector<Sample> samples;
+        samples.reserve(TIMELINE_CAPACITY);
+        void *arg = arg_provider();
+        int64_t duration = (int64_t)c.getTimelineMs() * 1000000;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(TIMELINE_SETTLE_MS));
+        warm_once(loop_count, arg);
+
+        int64_t start_nanos = nanos(), elapsed;
+        uint64_t start_tsc = __rdtsc();
+        do {
+            for (int i = 0; i < TIMELINE_CHECK_EVERY; i++) {
+                auto t0 = TIMER::now();
+                uint64_t tsc0 = __rdtsc();
+                method(loop_count, arg);
+                uint64_t tsc1 = __rdtsc();
+                auto t1 = TIMER::now();
+                samples.push_back({tsc0 - start_tsc, tsc1 - tsc0, TIMER::delta(t1, t0)});
+            }
+            elapsed = nanos() - start_nanos;
+        } while (elapsed < duration && samples.size() + TIMELINE_CHECK_EVERY <= TIMELINE_CAPACITY);
+        double tsc_ghz = (double)(__rdtsc() - start_tsc) / elapsed;
+
+        // the series, per op: reference cycles followed by the timer metrics
+        const TIMER& ti = static_cast<const TIMER&>(c.getTimerInfo());
+        std::vector<std::string> names{"Ref cycles"};
+        for (auto& name : ti.getMetricNames()) {
+            names.push_back(name);
+        }
+        size_t count = samples.size();
+        double ops = (double)loop_count * this->args.ops_per_loop;
+        std::vector<double> times(count);
+        std::vector<std::vector<double>> series(names.size(), std::vector<double>(count));
+        for (size_t i = 0; i < count; i++) {
+            const Sample& s = samples[i];
+            times[i] = s.start / tsc_ghz / 1000;
+            series[0][i] = s.ref_cycles / ops;
+            auto result = normalize(TIMER::to_result(ti, s.delta), this->args, loop_count).getResults();
+            for (size_t m = 0; m < result.size() && m + 1 < names.size(); m++) {
+                series[m + 1][i] = result[m];
+            }
+        }
+
+        c.out() << getPath() << ": " << count << " samples of " << (uint64_t)ops << " ops in "
+                << string_format("%.2f ms (TSC at %.3f GHz)", elapsed / 1000000.0, tsc_ghz);
+        if (elapsed < duration) {
+            c.out() << ", stopped early with the buffer full";
+        }
+        c.out() << std::endl;
+
+        printSlices(c, names, times, series);
+        printChangePoints(c, names, times, series);
+        if (!c.getTimelineDir().empty()) {
+            writeCsv(c, names, times, series);
+        }
+        c.out() << std::endl;
+    }
+
+private:
+
+    /* print the median of each metric over time slices of doubling length */
+    static void printSlices(Context& c, const std::vector<std::string>& names, const std::vector<double>& times,
+            const std::vector<std::vector<double>>& series) {
+        using namespace table;
+        int precision = c.getPrecision();
+        Table t;
+        auto& header = t.newRow().add("Time (us)").add("Samples");
+        for (auto& name : names) {
+            header.add(name);
+        }
+        for (size_t i = 1; i < names.size() + 2; i++) {
+            t.colInfo(i).justify = ColInfo::RIGHT;
+        }
+        double from = 0, to = TIMELINE_FIRST_SLICE_US;
+        size_t first = 0;
+        while (first < times.size()) {
+            size_t last = first;
+            while (last < times.size() && times[last] < to) {
+                last++;
+            }
+            if (last > first) {
+                auto& row = t.newRow().add(string_format("%.0f - %.0f", from, to)).add(last - first);
+                for (auto& s : series) {
+                    row.add(string_format("%.*f", precision, Stats::median(s.begin() + first, s.begin() + last)));
+                }
+            }
+            first = last;
+            from = to;
+            to *= 2;
+        }
+        c.out() << t.str();
+    }
+
+    static void printChangePoints(Context& c, const std::vector<std::string>& names, const std::vector<double>& times,
+            const std::vector<std::vector<double>>& series) {
+        using namespace table;
+        int precision = c.getPrecision();
+        Table t;
+        t.newRow().add("Metric").add("Time (us)").add("Sample").add("Before").add("After");
+        bool found = false;
+        for (size_t m = 0; m < names.size(); m++) {
+            auto points = find_change_points(series[m], TIMELINE_WINDOW, TIMELINE_CHANGE_TOL, TIMELINE_MIN_WINDOWS,
+                    TIMELINE_CHANGE_ABS);
+            for (auto& p : points) {
+                found = true;
+                t.newRow()
+                        .add(names[m])
+                        .add(string_format("%.1f", times[p.index]))
+                        .add(p.index)
+                        .add(string_format("%.*f", precision, p.before))
+                        .add(string_format("%.*f", precision, p.after));
+            }
+        }
+        if (found) {
+            c.out() << "Change points:" << std::endl << t.str();
+        } else {
+            c.out() << "No change points" << std::endl;
+        }
+    }
+
+    /* write every sample to <timeline-dir>/<path>.csv, with the / in the path replaced by _ */
+    void writeCsv(Context& c, const std::vector<std::string>& names, const std::vector<double>& times,
+            const std::vector<std::vector<double>>& series) {
+        std::string file = getPath();
+        std::replace(file.begin(), file.end(), '/', '_');
+        file = c.getTimelineDir() + "/" + file + ".csv";
+        std::ofstream out(file);
+        if (!out) {
+            throw std::runtime_error("couldn't open " + file + " for the timeline of " + getPath());
+        }
+        out << "Sample,Time (us)";
+        for (auto& name : names) {
+            out << "," << name;
+        }
+        out << "\n";
+        for (size_t i = 0; i < times.size(); i++) {
+            out << i << "," << times[i];
+            for (auto& s : series) {
+                out << "," << s[i];
+            }
+            out << "\n";
+        }
+        c.out() << "Wrote " << times.size() << " samples to " << file << std::endl;
+    }
+};
+
+/**
+ * A factory for timeline benchmarks, which run METHOD back-to-back for --timeline-ms, after running WARM_ONCE once.
+ */
+template <typename TIMER, bench2_f WARM_ONCE = inlined_empty>
+class TimelineMaker : public MakerBase<TIMER, TimelineMaker<TIMER, WARM_ONCE>> {
+public:
+    using base_t = MakerBase<TIMER, TimelineMaker<TIMER, WARM_ONCE>>;
+
+    TimelineMaker(BenchmarkGroup* parent, uint32_t loop_count = 1) : base_t{parent, loop_count} {}
+
+    template <bench2_f NEW_WARM>
+    TimelineMaker<TIMER, NEW_WARM> withWarm() {
+        TimelineMaker<TIMER, NEW_WARM> ret{this->parent, this->loop_count};
+        return ret.setTags(this->tags).setFeatures(this->features);
+    }
+
+    template <bench2_f METHOD>
+    void make(
+            const std::string& id,
+            const std::string& description,
+            uint32_t ops_per_invocation,
+            const arg_provider_t& arg_provider = null_provider)
+    {
+        Benchmark b = new TimelineBench<TIMER>(this->make_args(id, description, ops_per_invocation),
+                this->loop_count, METHOD, WARM_ONCE, arg_provider);
+        this->parent->add(b);
+    }
+};
+
+#endif /* TIMELINE_HPP_ */
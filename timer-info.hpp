@@ -57,6 +57,8 @@ typedef std::function<TimingResult (size_t)> full_bench_t;  // a full timing met
 struct TimerArgs {
     // a string of requested "extra events" passed via the --extra-events string
     std::string extra_events;
+    // true if --ports was passed: count the uops dispatched to each execution port
+    bool ports;
 };
 
 
@@ -111,6 +113,26 @@ public:
 	// is selected), and you should ouutput any additional supported events to Context.out()
 	virtual void listEvents(Context& c) = 0;
 
+	/*
+	 * The number of passes each benchmark is run for: timers which need more events than they have counters
+	 * (e.g., for --ports) program a different set of events for each pass. The first metric (cycles) is
+	 * recorded in every pass, and the others of each pass follow it in pass order.
+	 */
+	virtual unsigned getPassCount() const {
+	    return 1;
+	}
+
+	/*
+	 * Program the events for the given pass. Const since the programmed events are process-wide state, like
+	 * that read by the static now().
+	 */
+	virtual void setPass(unsigned pass) const {}
+
+	/* return extra text for the end of each result line, e.g., the bottleneck port with --ports */
+	virtual std::string annotate(const TimingResult& result) const {
+	    return {};
+	}
+
 	/***************************
 	 * Implementations of this class should additionally
 	 * implement the following static methods which called directly
@@ -3,6 +3,7 @@
  */
 
 #include "util.hpp"
+#include "numa.hpp"
 
 #include <regex>
 #include <cassert>
@@ -10,6 +11,11 @@
 #include <random>
 #include <cstring>
 #include <exception>
+#include <fstream>
+#include <cstdio>
+#include <cinttypes>
+#include <algorithm>
+#include <stdexcept>
 
 #include <sys/mman.h>
 
@@ -60,6 +66,8 @@ bool wildcard_match(const std::string& target, const std::string& pattern) {
 const size_t TWO_MB = 2 * 1024 * 1024;
 const int STORAGE_SIZE = 100 * 1024 * 1024;  // 100 MB
 void *storage_ptr = 0;
+const int SMALL_STORAGE_SIZE = 1024 * 1024;  // 1 MB, backed by 4 KiB pages
+void *small_storage_ptr = 0;
 
 volatile int zero = 0;
 bool storage_init = false;
@@ -74,6 +82,7 @@ void *new_huge_ptr(size_t size) {
     assert(result == 0);
     madvise(ptr, size + TWO_MB, MADV_HUGEPAGE);
     ptr = ((char *)ptr + TWO_MB);
+    numa_bind_range(ptr, size);
     // It is critical that we memset the memory region to touch each page, otherwise all or some pages
     // can be mapped to the zero page, leading to unexpected results for read-only tests (i.e., "too good to be true"
     // results for benchmarks that read large amounts of memory, because internally these are all mapped
@@ -86,6 +95,23 @@ void *new_huge_ptr(size_t size) {
     return ptr;
 }
 
+/**
+ * Return a new pointer to a page-aligned memory region of at least size bytes which is backed by small (4 KiB)
+ * pages, i.e., where we explicitly ask the kernel not to use transparent huge pages.
+ */
+void *new_small_page_ptr(size_t size) {
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        throw std::runtime_error("mmap failed in new_small_page_ptr: " + errno_to_str(errno));
+    }
+    madvise(ptr, size, MADV_NOHUGEPAGE);
+    numa_bind_range(ptr, size);
+    // see new_huge_ptr for why we touch the region twice
+    std::memset(ptr, 1, size);
+    std::memset(ptr, 0, size);
+    return ptr;
+}
+
 void *align(size_t base_alignment, size_t required_size, void* p, size_t space) {
     /* std::align isn't available in GCC and clang until fairly
      * recently. This just gives us a bit more portability for older
@@ -105,9 +131,17 @@ void *align(size_t base_alignment, size_t required_size, void* p, size_t space)
     return r;
 }
 
-void *aligned_ptr(size_t base_alignment, size_t required_size) {
-    assert(required_size <= STORAGE_SIZE);
+void *aligned_ptr(size_t base_alignment, size_t required_size, bool huge) {
     assert(is_pow2(base_alignment));
+    if (!huge) {
+        assert(required_size <= SMALL_STORAGE_SIZE);
+        assert(base_alignment <= 4096);
+        if (!small_storage_ptr) {
+            small_storage_ptr = new_small_page_ptr(SMALL_STORAGE_SIZE);
+        }
+        return align(base_alignment, required_size, small_storage_ptr, SMALL_STORAGE_SIZE);
+    }
+    assert(required_size <= STORAGE_SIZE);
     assert(base_alignment <= TWO_MB);
     if (!storage_ptr) {
         storage_ptr = new_huge_ptr(STORAGE_SIZE);
@@ -120,8 +154,8 @@ void *aligned_ptr(size_t base_alignment, size_t required_size) {
  * Returns a pointer that is first aligned to the given base alignment (per
  * aligned_ptr()) and then is offset by the amount given by misalignment.
  */
-void *misaligned_ptr(size_t base_alignment, size_t required_size, ssize_t misalignment) {
-    char *p = static_cast<char *>(aligned_ptr(base_alignment, required_size));
+void *misaligned_ptr(size_t base_alignment, size_t required_size, ssize_t misalignment, bool huge) {
+    char *p = static_cast<char *>(aligned_ptr(base_alignment, required_size, huge));
     return p + misalignment;
 }
 
@@ -186,6 +220,99 @@ region& shuffled_region(const size_t size, const size_t offset) {
     return *(new region{ size, storage }); // leak
 }
 
+region& page_chase_region(size_t pages, size_t page_size, bool huge) {
+    size_t size = pages * page_size;
+    assert(size <= MAX_PAGE_CHASE_SIZE);
+    assert(page_size % UB_CACHE_LINE_SIZE == 0);
+    assert(pages > 0);
+
+    static char* huge_storage  = static_cast<char*>(new_huge_ptr(MAX_PAGE_CHASE_SIZE));
+    static char* small_storage = static_cast<char*>(new_small_page_ptr(MAX_PAGE_CHASE_SIZE));
+    char* storage = huge ? huge_storage : small_storage;
+
+    // a line offset which is a simple function of the page index (e.g., page % lines_per_page) aliases with the
+    // page bits of the set index when the backing is contiguous (2 MiB pages), so pick the lines randomly
+    std::mt19937_64 rng{123};
+    std::uniform_int_distribution<size_t> line_dist(0, page_size / UB_CACHE_LINE_SIZE - 1);
+    std::vector<size_t> line_offsets(pages);
+    for (auto& offset : line_offsets) {
+        offset = line_dist(rng) * UB_CACHE_LINE_SIZE;
+    }
+    auto line_of = [&](size_t page) {
+        return reinterpret_cast<CacheLine*>(storage + page * page_size + line_offsets[page]);
+    };
+
+    std::vector<size_t> indexes(pages);
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::shuffle(indexes.begin(), indexes.end(), rng);
+
+    for (size_t i = 0; i < pages; i++) {
+        line_of(indexes[i])->setNexts(line_of(indexes[(i + 1) % pages]));
+    }
+
+    CacheLine* first = line_of(indexes[0]);
+    assert(count(first) == pages);
+
+    for (size_t page = 0; page < pages; page++) {
+        _mm_clflush(line_of(page));
+    }
+
+    _mm_mfence();
+
+    return *(new region{ size, first }); // leak
+}
+
+std::string thp_mode() {
+    std::ifstream f("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string line;
+    if (f && std::getline(f, line)) {
+        // the active mode is in brackets, like: always [madvise] never
+        auto start = line.find('['), end = line.find(']');
+        if (start != std::string::npos && end != std::string::npos && end > start) {
+            return line.substr(start + 1, end - start - 1);
+        }
+    }
+    return "unknown";
+}
+
+size_t anon_huge_bytes(const void *p) {
+    std::ifstream f("/proc/self/smaps");
+    std::string line;
+    bool in_mapping = false;
+    while (std::getline(f, line)) {
+        uintptr_t start, end;
+        // each mapping starts with a line like: 7f0e4c000000-7f0e4c200000 r-xp 00000000 00:00 0
+        if (std::sscanf(line.c_str(), "%" SCNxPTR "-%" SCNxPTR, &start, &end) == 2) {
+            in_mapping = (uintptr_t)p >= start && (uintptr_t)p < end;
+        } else if (in_mapping && line.compare(0, 14, "AnonHugePages:") == 0) {
+            return std::stoul(line.substr(14)) * 1024;
+        }
+    }
+    return 0;
+}
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    for (auto& range : split_on_any(list, ",\n")) {
+        if (range.empty()) {
+            continue;
+        }
+        auto bounds = split_on_string(range, "-");
+        if (bounds.size() > 2 || bounds.front().empty() || bounds.back().empty()) {
+            throw std::invalid_argument("bad range in cpu list: " + range);
+        }
+        int first = std::stoi(bounds.front()), last = std::stoi(bounds.back());
+        if (first > last) {
+            throw std::invalid_argument("bad range in cpu list: " + range);
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    return cpus;
+}
+
 std::string errno_to_str(int e) {
     char buf[128];
 #ifndef _GNU_SOURCE
@@ -38,8 +38,14 @@ static inline int64_t nanos() {
 }
 
 void *new_huge_ptr(size_t size);
-void *aligned_ptr(size_t base_alignment, size_t required_size);
-void *misaligned_ptr(size_t base_alignment, size_t required_size, ssize_t misalignment);
+void *new_small_page_ptr(size_t size);
+/*
+ * Return a pointer into a shared static storage area aligned to base_alignment. The storage is backed by huge pages
+ * (if available) unless huge is false, in which case it is backed by 4 KiB pages and base_alignment can be at most
+ * 4096.
+ */
+void *aligned_ptr(size_t base_alignment, size_t required_size, bool huge = true);
+void *misaligned_ptr(size_t base_alignment, size_t required_size, ssize_t misalignment, bool huge = true);
 
 /*
  * Given a printf-style format and args, return the formatted string as a std::string.
@@ -145,6 +151,39 @@ struct region {
  */
 region& shuffled_region(const size_t size, const size_t offset = 0);
 
+constexpr size_t MAX_PAGE_CHASE_SIZE = 64 * 1024 * 1024;
+
+/**
+ * Return a region of pages * page_size bytes where exactly one cache line in each page_size chunk is part of
+ * a single pointer-chasing cycle which visits the pages in random order. The line used within each page is chosen
+ * pseudo-randomly, so that the visited lines are spread across the cache sets in the same way regardless of
+ * whether the backing pages are physically contiguous.
+ *
+ * If huge is true, the region is backed by 2 MiB pages (if transparent huge pages are available), otherwise
+ * it is backed by 4 KiB pages.
+ *
+ * Like shuffled_region(), the storage is shared across calls, so only one region of each backing is valid at a time.
+ */
+region& page_chase_region(size_t pages, size_t page_size, bool huge);
+
+/**
+ * Return the current transparent huge page mode, as configured in /sys/kernel/mm/transparent_hugepage/enabled,
+ * e.g., "always", "madvise" or "never", or "unknown" if it couldn't be determined.
+ */
+std::string thp_mode();
+
+/**
+ * Return the bytes of the mapping containing p which are backed by transparent huge pages, according to the
+ * AnonHugePages line of /proc/self/smaps, or 0 if it couldn't be determined.
+ */
+size_t anon_huge_bytes(const void *p);
+
+/**
+ * Parse a CPU list in the format used by the kernel in sysfs and elsewhere, e.g., "0-3,8,10-11", into a
+ * sorted list of CPU ids. Throws std::invalid_argument if the list is malformed.
+ */
+std::vector<int> parse_cpu_list(const std::string& list);
+
 /**
  * Return the string description of the given system errno
  */
@@ -0,0 +1,205 @@
+/*
+ * vector-benches-gather.cpp
+ *
+ * Gather and scatter throughput by index pattern: AVX2 gathers and AVX-512 gathers and scatters, for indices which
+ * are all the same, contiguous, strided, within one cache line, or random within footprints that fit in roughly
+ * L1, L2 and L3. Results are in cycles per element.
+ */
+
+#include <random>
+#include <functional>
+#include <cmath>
+#include <cstring>
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "table.hpp"
+#include "simple-timer.hpp"
+#include "isa-support.hpp"
+
+extern "C" {
+bench2_f avx2_gather_dd;
+bench2_f avx2_gather_qq;
+bench2_f avx512_gather_dd;
+bench2_f avx512_gather_qq;
+bench2_f avx512_scatter_dd;
+bench2_f avx512_scatter_qq;
+}
+
+using namespace std;
+
+/* the argument for the gather kernels, mirror of gather_args in x86_helpers.asm */
+struct GatherArgs {
+    void *base;
+    void *indices;
+    /* the size of the index table in bytes, minus one (the table size is a power of two) */
+    size_t mask;
+};
+
+/* the largest footprint of any pattern */
+constexpr size_t GATHER_REGION_SIZE = 8 * 1024 * 1024;
+/* the footprints of the random patterns, which should fit in roughly L1, L2 and L3 */
+constexpr size_t GATHER_L1 = 16 * 1024, GATHER_L2 = 256 * 1024, GATHER_L3 = GATHER_REGION_SIZE;
+/* the minimum number of distinct index vectors, so that the index loads themselves don't repeat too often */
+constexpr size_t GATHER_MIN_VECTORS = 16;
+
+/*
+ * All the kernels: method, id, element count (lanes), element size in bytes, required features. Every kernel reads
+ * one index vector (of the same width as the data vector) per gather.
+ */
+#define GATHER_KERNELS_X(f) \
+    f(avx2_gather_dd,    "vpgatherdd-ymm",   8, 4, AVX2   ) \
+    f(avx2_gather_qq,    "vpgatherqq-ymm",   4, 8, AVX2   ) \
+    f(avx512_gather_dd,  "vpgatherdd-zmm",  16, 4, AVX512F) \
+    f(avx512_gather_qq,  "vpgatherqq-zmm",   8, 8, AVX512F) \
+    f(avx512_scatter_dd, "vpscatterdd-zmm", 16, 4, AVX512F) \
+    f(avx512_scatter_qq, "vpscatterqq-zmm",  8, 8, AVX512F)
+
+/* an index pattern: how the byte offset of each element is chosen, within a footprint */
+struct IndexPattern {
+    typedef std::function<size_t(size_t vec, size_t lane, size_t lanes, size_t esize, std::mt19937_64& rng)> offset_f;
+
+    string id, desc;
+    size_t footprint;
+    /* return the byte offset (a multiple of esize, less than footprint) of the given element */
+    offset_f offset;
+};
+
+static const vector<IndexPattern>& index_patterns() {
+    static const vector<IndexPattern> patterns = {
+        { "same",        "all lanes the same element", GATHER_L1,
+                [](size_t vec, size_t, size_t, size_t, std::mt19937_64&) { return vec * UB_CACHE_LINE_SIZE; } },
+        { "contiguous",  "contiguous elements", GATHER_L1,
+                [](size_t vec, size_t lane, size_t lanes, size_t esize, std::mt19937_64&) { return (vec * lanes + lane) * esize; } },
+        { "stride-64",   "one element per cache line", GATHER_L1,
+                [](size_t vec, size_t lane, size_t lanes, size_t, std::mt19937_64&) { return (vec * lanes + lane) * 64; } },
+        { "stride-4096", "one element per 4 KiB page", 1024 * 1024,
+                [](size_t vec, size_t lane, size_t lanes, size_t, std::mt19937_64&) { return (vec * lanes + lane) * 4096; } },
+        { "same-line",   "random elements within one cache line", GATHER_L1,
+                [](size_t vec, size_t, size_t, size_t esize, std::mt19937_64& rng) {
+                    return vec * UB_CACHE_LINE_SIZE + rng() % (UB_CACHE_LINE_SIZE / esize) * esize; } },
+        { "random-16k",  "random elements in 16 KiB (L1)", GATHER_L1,
+                [](size_t, size_t, size_t, size_t esize, std::mt19937_64& rng) { return rng() % (GATHER_L1 / esize) * esize; } },
+        { "random-256k", "random elements in 256 KiB (L2)", GATHER_L2,
+                [](size_t, size_t, size_t, size_t esize, std::mt19937_64& rng) { return rng() % (GATHER_L2 / esize) * esize; } },
+        { "random-8m",   "random elements in 8 MiB (L3)", GATHER_L3,
+                [](size_t, size_t, size_t, size_t esize, std::mt19937_64& rng) { return rng() % (GATHER_L3 / esize) * esize; } },
+    };
+    return patterns;
+}
+
+/*
+ * Runs every kernel with every index pattern, then prints a table of cycles per element by pattern and kernel.
+ */
+class GatherGroup : public BenchmarkGroup {
+    struct Entry {
+        size_t pattern, kernel;
+    };
+
+    /* parallel to getBenches() */
+    vector<Entry> entries_;
+    vector<string> kernels_;
+    vector<char> indices_;
+    GatherArgs args_;
+
+public:
+    GatherGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    /*
+     * Build the index table for the given pattern and kernel shape. There is one index vector for each cache line in
+     * the footprint divided by the lanes (so the random patterns touch every line about once per pass over the
+     * table), rounded up to a power of two and at least GATHER_MIN_VECTORS. Offsets wrap around the footprint.
+     */
+    void *args_for(const IndexPattern& p, size_t lanes, size_t esize) {
+        size_t vectors = GATHER_MIN_VECTORS;
+        while (vectors < p.footprint / UB_CACHE_LINE_SIZE / lanes) {
+            vectors *= 2;
+        }
+        size_t vec_bytes = lanes * esize;
+        indices_.assign(vectors * vec_bytes, 0);
+        std::mt19937_64 rng{123};
+        for (size_t v = 0; v < vectors; v++) {
+            for (size_t lane = 0; lane < lanes; lane++) {
+                size_t offset = p.offset(v, lane, lanes, esize, rng) % p.footprint;
+                assert(offset % esize == 0);
+                uint64_t index = offset / esize;
+                memcpy(&indices_[v * vec_bytes + lane * esize], &index, esize);
+            }
+        }
+        static void *base = aligned_ptr(4096, GATHER_REGION_SIZE);
+        args_ = { base, indices_.data(), indices_.size() - 1 };
+        return &args_;
+    }
+
+    template <typename TIMER>
+    static shared_ptr<GatherGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<GatherGroup>(id, desc);
+        GatherGroup* g = group.get();
+        auto maker = DeltaMaker<TIMER>(g, 10000);
+        auto& patterns = index_patterns();
+#define MAKE_GATHER(method, kid, lanes, esize, feature)                                                          \
+        for (size_t pi = 0; pi < patterns.size(); pi++) {                                                        \
+            const IndexPattern* p = &patterns[pi];                                                               \
+            maker.setFeatures({feature}).template make<method>(kid "-" + p->id, kid " " + p->desc, lanes,        \
+                    [g, p]{ return g->args_for(*p, lanes, esize); });                                            \
+            g->entries_.push_back({pi, g->kernels_.size()});                                                     \
+        }                                                                                                        \
+        g->kernels_.push_back(kid);
+        GATHER_KERNELS_X(MAKE_GATHER)
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == entries_.size());
+
+        auto& patterns = index_patterns();
+        // cycles[pattern][kernel], NAN if not run
+        vector<vector<double>> cycles(patterns.size(), vector<double>(kernels_.size(), NAN));
+
+        bool header = false;
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b) || !supports(b->getFeatures())) {
+                continue;
+            }
+            if (!header) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                printGroupHeader(c);
+                header = true;
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            cycles[entries_[i].pattern][entries_[i].kernel] = result.getCycles();
+        }
+
+        if (!header) {
+            return;
+        }
+
+        using namespace table;
+        Table t;
+        auto& row = t.newRow().add("Pattern");
+        for (auto& k : kernels_) {
+            row.add(k);
+        }
+        for (size_t p = 0; p < patterns.size(); p++) {
+            auto& row = t.newRow().add(patterns[p].id);
+            for (size_t k = 0; k < kernels_.size(); k++) {
+                row.add(std::isnan(cycles[p][k]) ? string("-") : string_format("%.2f", cycles[p][k]));
+            }
+        }
+        c.out() << endl << "Cycles per element:" << endl << t.str();
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+};
+
+template <typename TIMER>
+void register_vector_gather(GroupList& list) {
+    list.push_back(GatherGroup::make<TIMER>("vector/gather", "Gather and scatter throughput by index pattern"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_vector_gather<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -0,0 +1,261 @@
+/*
+ * vector-benches-masked.cpp
+ *
+ * Masked loads and stores: AVX vmaskmovps/pd, AVX2 vpmaskmovd/q and AVX-512 masked vmovdqu32, with all-true, partial
+ * and all-false masks, with masked-off lanes which fall on a protected or unmapped page (fault suppression), and
+ * the latency of a masked store followed by a dependent load from the same address (store forwarding).
+ */
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <cerrno>
+
+#include <sys/mman.h>
+
+#include "benchmark.hpp"
+#include "util.hpp"
+#include "table.hpp"
+#include "simple-timer.hpp"
+#include "isa-support.hpp"
+
+extern "C" {
+bench2_f vmaskmovps_load;
+bench2_f vmaskmovps_store;
+bench2_f vpmaskmovd_load;
+bench2_f vpmaskmovd_store;
+bench2_f vmaskmovpd_load;
+bench2_f vmaskmovpd_store;
+bench2_f vpmaskmovq_load;
+bench2_f vpmaskmovq_store;
+bench2_f avx512_masked_load;
+bench2_f avx512_masked_store;
+bench2_f vmaskmovps_store_load;
+bench2_f vpmaskmovd_store_load;
+bench2_f vmaskmovpd_store_load;
+bench2_f vpmaskmovq_store_load;
+bench2_f avx512_masked_store_load;
+}
+
+using namespace std;
+
+/* the argument for the masked kernels, mirror of mask_args in x86_helpers.asm */
+struct MaskArgs {
+    void *ptr;
+    int32_t vmask[8];
+    uint64_t kmask;
+};
+
+constexpr size_t MASK_PAGE_SIZE = 4096;
+
+/* the throughput kernels: method, id, lanes, bytes per lane, required feature */
+#define MASKED_TPUT_X(f) \
+    f(vmaskmovps_load,     "vmaskmovps-load",   8, 4, AVX    ) \
+    f(vmaskmovps_store,    "vmaskmovps-store",  8, 4, AVX    ) \
+    f(vmaskmovpd_load,     "vmaskmovpd-load",   4, 8, AVX    ) \
+    f(vmaskmovpd_store,    "vmaskmovpd-store",  4, 8, AVX    ) \
+    f(vpmaskmovd_load,     "vpmaskmovd-load",   8, 4, AVX2   ) \
+    f(vpmaskmovd_store,    "vpmaskmovd-store",  8, 4, AVX2   ) \
+    f(vpmaskmovq_load,     "vpmaskmovq-load",   4, 8, AVX2   ) \
+    f(vpmaskmovq_store,    "vpmaskmovq-store",  4, 8, AVX2   ) \
+    f(avx512_masked_load,  "avx512-load",      16, 4, AVX512F) \
+    f(avx512_masked_store, "avx512-store",     16, 4, AVX512F)
+
+/* the store then dependent load kernels: method, id, lanes, bytes per lane, required feature */
+#define MASKED_LAT_X(f) \
+    f(vmaskmovps_store_load,    "vmaskmovps-store-load",  8, 4, AVX    ) \
+    f(vmaskmovpd_store_load,    "vmaskmovpd-store-load",  4, 8, AVX    ) \
+    f(vpmaskmovd_store_load,    "vpmaskmovd-store-load",  8, 4, AVX2   ) \
+    f(vpmaskmovq_store_load,    "vpmaskmovq-store-load",  4, 8, AVX2   ) \
+    f(avx512_masked_store_load, "avx512-store-load",     16, 4, AVX512F)
+
+/* a mask and where the access is relative to an inaccessible page */
+struct MaskCase {
+    enum Active { ALL, HALF, NONE };
+    enum Where {
+        /* the whole vector is in an ordinary page */
+        NORMAL,
+        /* the active lanes end at the end of an ordinary page, followed by a PROT_NONE page */
+        PROTECTED,
+        /* the same, but followed by an unmapped page */
+        UNMAPPED
+    };
+
+    string id, desc;
+    Active active;
+    Where where;
+    /* does this case apply to the store-load latency kernels */
+    bool latency;
+};
+
+static const vector<MaskCase>& mask_cases() {
+    static const vector<MaskCase> cases = {
+        { "all-true",            "all lanes",                              MaskCase::ALL,  MaskCase::NORMAL,    true  },
+        { "partial",             "low half lanes",                         MaskCase::HALF, MaskCase::NORMAL,    true  },
+        { "all-false",           "no lanes",                               MaskCase::NONE, MaskCase::NORMAL,    true  },
+        { "partial-protected",   "low half lanes, high half protected",    MaskCase::HALF, MaskCase::PROTECTED, false },
+        { "partial-unmapped",    "low half lanes, high half unmapped",     MaskCase::HALF, MaskCase::UNMAPPED,  false },
+        { "all-false-protected", "no lanes, all on a protected page",      MaskCase::NONE, MaskCase::PROTECTED, false },
+    };
+    return cases;
+}
+
+/*
+ * Return two zeroed pages where the second is inaccessible: PROT_NONE if unmapped is false, otherwise unmapped.
+ * The unmapped page could in principle be reused by a later mapping, so callers should check it with
+ * check_unmapped() before relying on it.
+ */
+static char *guarded_pages(bool unmapped) {
+    void *p = mmap(nullptr, 2 * MASK_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("mmap failed in guarded_pages: " + errno_to_str(errno));
+    }
+    char *page = static_cast<char *>(p);
+    int ret = unmapped ? munmap(page + MASK_PAGE_SIZE, MASK_PAGE_SIZE) : mprotect(page + MASK_PAGE_SIZE, MASK_PAGE_SIZE, PROT_NONE);
+    if (ret) {
+        throw std::runtime_error("munmap/mprotect failed in guarded_pages: " + errno_to_str(errno));
+    }
+    std::memset(page, 0, MASK_PAGE_SIZE);
+    return page;
+}
+
+static void check_unmapped(char *page) {
+    unsigned char vec;
+    if (mincore(page, MASK_PAGE_SIZE, &vec) == 0 || errno != ENOMEM) {
+        throw std::runtime_error("the unmapped guard page for vector/masked has been mapped again");
+    }
+}
+
+/*
+ * Runs the throughput kernels and the store-load latency kernels for each mask case, then prints a table for each.
+ */
+class MaskedGroup : public BenchmarkGroup {
+    struct Entry {
+        size_t mask_case, kernel;
+        bool latency;
+    };
+
+    /* parallel to getBenches() */
+    vector<Entry> entries_;
+    vector<string> tput_kernels_, lat_kernels_;
+    MaskArgs args_;
+
+public:
+    MaskedGroup(const string& id, const string& desc) : BenchmarkGroup(id, desc) {}
+
+    /* the args for the given case with lanes of lane_bytes (4 or 8) each */
+    void *args_for(const MaskCase& mc, size_t lanes, size_t lane_bytes) {
+        static char *protected_pages = guarded_pages(false);
+        static char *unmapped_pages  = guarded_pages(true);
+
+        size_t active = mc.active == MaskCase::ALL ? lanes : mc.active == MaskCase::HALF ? lanes / 2 : 0;
+        std::memset(&args_, 0, sizeof(args_));
+        for (size_t lane = 0; lane < active; lane++) {
+            // the vector mask is the top bit of each lane, so set every dword of an active qword lane
+            for (size_t d = 0; d < lane_bytes / sizeof(int32_t); d++) {
+                args_.vmask[lane * lane_bytes / sizeof(int32_t) + d] = -1;
+            }
+            args_.kmask |= 1ull << lane;
+        }
+
+        char *page = mc.where == MaskCase::UNMAPPED ? unmapped_pages : protected_pages;
+        if (mc.where == MaskCase::UNMAPPED) {
+            check_unmapped(page + MASK_PAGE_SIZE);
+        }
+        args_.ptr = mc.where == MaskCase::NORMAL ? page : page + MASK_PAGE_SIZE - active * lane_bytes;
+        std::memset(page, 0, MASK_PAGE_SIZE);
+        return &args_;
+    }
+
+    template <typename TIMER>
+    static shared_ptr<MaskedGroup> make(const string& id, const string& desc) {
+        auto group = make_shared<MaskedGroup>(id, desc);
+        MaskedGroup* g = group.get();
+        auto maker = DeltaMaker<TIMER>(g, 1000);
+        auto& cases = mask_cases();
+#define MAKE_MASKED(method, kid, lanes, lane_bytes, feature, ops, is_latency, kernels)                          \
+        for (size_t ci = 0; ci < cases.size(); ci++) {                                                          \
+            const MaskCase* mc = &cases[ci];                                                                    \
+            if (is_latency && !mc->latency) {                                                                   \
+                continue;                                                                                       \
+            }                                                                                                   \
+            maker.setFeatures({feature}).template make<method>(kid "-" + mc->id, kid " " + mc->desc, ops,       \
+                    [g, mc]{ return g->args_for(*mc, lanes, lane_bytes); });                                    \
+            g->entries_.push_back({ci, g->kernels.size(), is_latency});                                         \
+        }                                                                                                       \
+        g->kernels.push_back(kid);
+#define MAKE_TPUT(method, kid, lanes, lane_bytes, feature) \
+        MAKE_MASKED(method, kid, lanes, lane_bytes, feature, 8, false, tput_kernels_)
+#define MAKE_LAT(method, kid, lanes, lane_bytes, feature) \
+        MAKE_MASKED(method, kid, lanes, lane_bytes, feature, 1, true,  lat_kernels_)
+        MASKED_TPUT_X(MAKE_TPUT)
+        MASKED_LAT_X(MAKE_LAT)
+        return group;
+    }
+
+    virtual void runIf(Context& c, const predicate_t& predicate) override {
+        SimpleTimer timer;
+        auto& benches = getBenches();
+        assert(benches.size() == entries_.size());
+
+        auto& cases = mask_cases();
+        // cycles[case][kernel], NAN if not run
+        vector<vector<double>> tput(cases.size(), vector<double>(tput_kernels_.size(), NAN));
+        vector<vector<double>> lat (cases.size(), vector<double>(lat_kernels_.size(),  NAN));
+
+        bool header = false;
+        for (size_t i = 0; i < benches.size(); i++) {
+            const Benchmark& b = benches[i];
+            if (!predicate(b) || !supports(b->getFeatures())) {
+                continue;
+            }
+            if (!header) {
+                c.out() << std::endl << "** Running group " << getId() << " : " << getDescription() << " **" << std::endl;
+                printGroupHeader(c);
+                header = true;
+            }
+            TimingResult result = b->run(c.getTimerInfo());
+            printResultLine(c, b, result);
+            auto& e = entries_[i];
+            (e.latency ? lat : tput)[e.mask_case][e.kernel] = result.getCycles();
+        }
+
+        if (!header) {
+            return;
+        }
+
+        printTable(c, "Inverse throughput, cycles per instruction:", tput_kernels_, tput, false);
+        printTable(c, "Masked store then dependent load from the same address, latency in cycles:", lat_kernels_, lat, true);
+        c.out() << "Finished in " << timer.elapsed<std::chrono::milliseconds>() << " ms (" << getId() << ")" << endl;
+    }
+
+    static void printTable(Context& c, const string& title, const vector<string>& kernels,
+            const vector<vector<double>>& cycles, bool latency) {
+        using namespace table;
+        auto& cases = mask_cases();
+        Table t;
+        auto& header = t.newRow().add("Mask");
+        for (auto& k : kernels) {
+            header.add(k);
+        }
+        for (size_t ci = 0; ci < cases.size(); ci++) {
+            if (latency && !cases[ci].latency) {
+                continue;
+            }
+            auto& row = t.newRow().add(cases[ci].id);
+            for (size_t k = 0; k < kernels.size(); k++) {
+                row.add(std::isnan(cycles[ci][k]) ? string("-") : string_format("%.2f", cycles[ci][k]));
+            }
+        }
+        c.out() << endl << title << endl << t.str();
+    }
+};
+
+template <typename TIMER>
+void register_vector_masked(GroupList& list) {
+    list.push_back(MaskedGroup::make<TIMER>("vector/masked", "Masked loads and stores and fault suppression"));
+}
+
+#define REG_DEFAULT(CLOCK) template void register_vector_masked<CLOCK>(GroupList& list);
+
+ALL_TIMERS_X(REG_DEFAULT)
@@ -29,6 +29,12 @@ bench2_f vector_load_load_lat_vlddqu_63;
 
 }
 
+template <typename TIMER>
+void register_vector_gather(GroupList& list);
+
+template <typename TIMER>
+void register_vector_masked(GroupList& list);
+
 template <typename TIMER>
 void register_vector(GroupList& list) {
     {
@@ -71,6 +77,9 @@ void register_vector(GroupList& list) {
         vector_group->add(benches);
         list.push_back(vector_group);
     }
+
+    register_vector_gather<TIMER>(list);
+    register_vector_masked<TIMER>(list);
 }
 
 #define REG_DEFAULT(CLOCK) template void register_vector<CLOCK>(GroupList& list);
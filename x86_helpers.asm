@@ -116,3 +116,24 @@ struc region
     .size  : resq 1
     .start : resq 1
 endstruc
+
+; mirror of mem-benches-copy.cpp::CopyArgs
+struc copy_args
+    .dst   : resq 1
+    .src   : resq 1
+    .size  : resq 1
+endstruc
+
+; mirror of vector-benches-gather.cpp::GatherArgs
+struc gather_args
+    .base    : resq 1
+    .indices : resq 1
+    .mask    : resq 1
+endstruc
+
+; mirror of vector-benches-masked.cpp::MaskArgs
+struc mask_args
+    .ptr   : resq 1
+    .vmask : resd 8
+    .kmask : resq 1
+endstruc
@@ -0,0 +1,290 @@
+BITS 64
+default rel
+
+%include "nasm-utils/nasm-utils-inc.asm"
+%include "x86_helpers.asm"
+
+nasm_util_assert_boilerplate
+thunk_boilerplate
+
+; The instruction table benchmarks (instructions/table). Every form in instructions.inc generates three
+; benchmarks, each executing 32 instances of the instruction per iteration:
+;
+;   insn_<id>_lat   a dependency chain through the destination, alternating between the A and B registers
+;                   so the chain also covers forms whose destination is write-only (e.g., popcnt)
+;   insn_<id>_tput  rotating through the independent destinations T0, T1, ... (8 for the gp types, 14 for
+;                   the vector types), with the read-only sources S1 and S2
+;   insn_<id>_mem   as _tput but with the last source from memory at [rsi], or for the one-operand (R) and
+;                   immediate (RI) shapes, a read-modify-write of 32 distinct lines starting at rsi
+;
+; A destructive form (e.g., pmulld xmm, xmm) makes each destination a chain, so _tput is only the reciprocal
+; throughput while latency / destinations is below it: the vector types have 14 destinations for forms like
+; pmulld (latency 10, 1 per cycle), whose longest chain is then 3 instructions per 32.
+;
+; The shapes are:
+;   R    mn dst
+;   RI   mn dst, 1
+;   RR   mn dst, src
+;   RRR  mn dst, src1, src2
+;
+; All the registers an operand type uses are zeroed on entry, so the FP forms never see denormals.
+
+; the registers for each operand type
+%define R64_A   rax
+%define R64_B   rcx
+%define R64_S1  rdx
+%define R64_S2  rbx
+%define R64_T0  r8
+%define R64_T1  r9
+%define R64_T2  r10
+%define R64_T3  r11
+%define R64_T4  r12
+%define R64_T5  r13
+%define R64_T6  r14
+%define R64_T7  r15
+%define R64_TCOUNT 8
+%define R64_MEM qword
+
+%define R32_A   eax
+%define R32_B   ecx
+%define R32_S1  edx
+%define R32_S2  ebx
+%define R32_T0  r8d
+%define R32_T1  r9d
+%define R32_T2  r10d
+%define R32_T3  r11d
+%define R32_T4  r12d
+%define R32_T5  r13d
+%define R32_T6  r14d
+%define R32_T7  r15d
+%define R32_TCOUNT 8
+%define R32_MEM dword
+
+%define XMM_A   xmm0
+%define XMM_B   xmm1
+%define XMM_S1  xmm14
+%define XMM_S2  xmm15
+%define XMM_T0  xmm2
+%define XMM_T1  xmm3
+%define XMM_T2  xmm4
+%define XMM_T3  xmm5
+%define XMM_T4  xmm6
+%define XMM_T5  xmm7
+%define XMM_T6  xmm8
+%define XMM_T7  xmm9
+%define XMM_T8  xmm10
+%define XMM_T9  xmm11
+%define XMM_T10 xmm12
+%define XMM_T11 xmm13
+%define XMM_T12 xmm0
+%define XMM_T13 xmm1
+%define XMM_TCOUNT 14
+%define XMM_MEM
+
+%define YMM_A   ymm0
+%define YMM_B   ymm1
+%define YMM_S1  ymm14
+%define YMM_S2  ymm15
+%define YMM_T0  ymm2
+%define YMM_T1  ymm3
+%define YMM_T2  ymm4
+%define YMM_T3  ymm5
+%define YMM_T4  ymm6
+%define YMM_T5  ymm7
+%define YMM_T6  ymm8
+%define YMM_T7  ymm9
+%define YMM_T8  ymm10
+%define YMM_T9  ymm11
+%define YMM_T10 ymm12
+%define YMM_T11 ymm13
+%define YMM_T12 ymm0
+%define YMM_T13 ymm1
+%define YMM_TCOUNT 14
+%define YMM_MEM
+
+; zmm16-31 so that no upper ymm state is dirtied
+%define ZMM_A   zmm16
+%define ZMM_B   zmm17
+%define ZMM_S1  zmm30
+%define ZMM_S2  zmm31
+%define ZMM_T0  zmm18
+%define ZMM_T1  zmm19
+%define ZMM_T2  zmm20
+%define ZMM_T3  zmm21
+%define ZMM_T4  zmm22
+%define ZMM_T5  zmm23
+%define ZMM_T6  zmm24
+%define ZMM_T7  zmm25
+%define ZMM_T8  zmm26
+%define ZMM_T9  zmm27
+%define ZMM_T10 zmm28
+%define ZMM_T11 zmm29
+%define ZMM_T12 zmm16
+%define ZMM_T13 zmm17
+%define ZMM_TCOUNT 14
+%define ZMM_MEM
+
+; zero the registers of an operand type
+%macro insn_zero_R64 0
+xor     eax, eax
+xor     ecx, ecx
+xor     edx, edx
+xor     ebx, ebx
+%assign n 8
+%rep 8
+xor     r %+ n %+ d, r %+ n %+ d
+%assign n n+1
+%endrep
+%endmacro
+
+%define insn_zero_R32 insn_zero_R64
+
+%macro insn_zero_XMM 0
+%assign n 0
+%rep 16
+pxor    xmm %+ n, xmm %+ n
+%assign n n+1
+%endrep
+%endmacro
+
+%macro insn_zero_YMM 0
+vzeroall
+%endmacro
+
+%macro insn_zero_ZMM 0
+%assign n 16
+%rep 16
+vpxord  zmm %+ n, zmm %+ n, zmm %+ n
+%assign n n+1
+%endrep
+%endmacro
+
+; clean up after an operand type
+%define insn_clean_R64
+%define insn_clean_R32
+%define insn_clean_XMM
+%define insn_clean_YMM vzeroupper
+%define insn_clean_ZMM vzeroupper
+
+; one latency chain step (two instructions) for each shape: %1 mnemonic, %2 type
+%macro insn_lat_R 2
+%1      %2_A
+%1      %2_A
+%endmacro
+
+%macro insn_lat_RI 2
+%1      %2_A, 1
+%1      %2_A, 1
+%endmacro
+
+%macro insn_lat_RR 2
+%1      %2_A, %2_B
+%1      %2_B, %2_A
+%endmacro
+
+%macro insn_lat_RRR 2
+%1      %2_A, %2_A, %2_B
+%1      %2_B, %2_B, %2_A
+%endmacro
+
+; one independent instruction for each shape: %1 mnemonic, %2 type, %3 destination index
+%macro insn_tput_R 3
+%1      %2_T%3
+%endmacro
+
+%macro insn_tput_RI 3
+%1      %2_T%3, 1
+%endmacro
+
+%macro insn_tput_RR 3
+%1      %2_T%3, %2_S1
+%endmacro
+
+%macro insn_tput_RRR 3
+%1      %2_T%3, %2_S1, %2_S2
+%endmacro
+
+; the same with a memory operand: %1 mnemonic, %2 type, %3 destination index, %4 copy index (0 - 31), which gives
+; each read-modify-write copy its own line so that none of them waits on the store of another
+%macro insn_mem_R 4
+%1      %2_MEM [rsi + 64 * %4]
+%endmacro
+
+%macro insn_mem_RI 4
+%1      %2_MEM [rsi + 64 * %4], 1
+%endmacro
+
+%macro insn_mem_RR 4
+%1      %2_T%3, %2_MEM [rsi]
+%endmacro
+
+%macro insn_mem_RRR 4
+%1      %2_T%3, %2_S1, %2_MEM [rsi]
+%endmacro
+
+; the common prologue and epilogue, saving the callee-saved registers the R64 and R32 types use
+%macro insn_prologue 1
+push    rbx
+push    r12
+push    r13
+push    r14
+push    r15
+insn_zero_%1
+%endmacro
+
+%macro insn_epilogue 1
+insn_clean_%1
+pop     r15
+pop     r14
+pop     r13
+pop     r12
+pop     rbx
+ret
+%endmacro
+
+; generate the three benchmarks for one instruction form
+; %1 id, %2 mnemonic, %3 shape, %4 operand type, %5 ISA feature (only used by the C++ side)
+%macro insn_form 5
+
+define_bench insn_%1_lat
+insn_prologue %4
+.top:
+%rep 16
+insn_lat_%3 %2, %4
+%endrep
+dec     rdi
+jnz     .top
+insn_epilogue %4
+
+define_bench insn_%1_tput
+insn_prologue %4
+.top:
+%assign copy 0
+%rep 32
+%assign t copy % %4_TCOUNT
+insn_tput_%3 %2, %4, t
+%assign copy copy+1
+%endrep
+dec     rdi
+jnz     .top
+insn_epilogue %4
+
+define_bench insn_%1_mem
+insn_prologue %4
+.top:
+%assign copy 0
+%rep 32
+%assign t copy % %4_TCOUNT
+insn_mem_%3 %2, %4, t, copy
+%assign copy copy+1
+%endrep
+dec     rdi
+jnz     .top
+insn_epilogue %4
+
+%endmacro
+
+%define INSN(id, mnemonic, shape, type, feature) insn_form id, mnemonic, shape, type, feature
+%include "instructions.inc"
+
+ud2
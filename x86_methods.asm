@@ -2643,5 +2643,618 @@ define_bench syscall_misses_lfence
 parallel_miss_macro syscall_123456_lfence
 
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+; atomics: locked instructions, xchg and mfence
+;
+; rsi points to 4 64-byte aligned lines, and each benchmark executes 8
+; atomic operations per iteration. The dep_ variants all target the first
+; line (and, where the instruction has a register result, chain through it)
+; while the indep_ variants spread the operations across the 4 lines using
+; separate registers. The lines may hold any values: the cmpxchg "success"
+; variants read each targeted line before the loop and use its value as both
+; the comparand and the new value, so every compare succeeds and the line
+; keeps its value.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+define_bench dep_lock_add
+mov     eax, 1
+.top:
+%rep 8
+lock add [rsi], rax
+%endrep
+dec     rdi
+jnz     .top
+ret
+
+define_bench indep_lock_add
+mov     eax, 1
+.top:
+%rep 2
+lock add [rsi      ], rax
+lock add [rsi +  64], rax
+lock add [rsi + 128], rax
+lock add [rsi + 192], rax
+%endrep
+dec     rdi
+jnz     .top
+ret
+
+define_bench dep_lock_xadd
+xor     eax, eax
+.top:
+%rep 8
+lock xadd [rsi], rax
+%endrep
+dec     rdi
+jnz     .top
+ret
+
+define_bench indep_lock_xadd
+mov     eax, 1
+mov     ecx, 1
+mov     edx, 1
+mov     r8d, 1
+.top:
+%rep 2
+lock xadd [rsi      ], rax
+lock xadd [rsi +  64], rcx
+lock xadd [rsi + 128], rdx
+lock xadd [rsi + 192], r8
+%endrep
+dec     rdi
+jnz     .top
+ret
+
+; xchg with a memory operand is implicitly locked
+define_bench dep_xchg
+xor     eax, eax
+.top:
+%rep 8
+xchg    [rsi], rax
+%endrep
+dec     rdi
+jnz     .top
+ret
+
+define_bench indep_xchg
+xor     eax, eax
+xor     ecx, ecx
+xor     edx, edx
+xor     r8d, r8d
+.top:
+%rep 2
+xchg    [rsi      ], rax
+xchg    [rsi +  64], rcx
+xchg    [rsi + 128], rdx
+xchg    [rsi + 192], r8
+%endrep
+dec     rdi
+jnz     .top
+ret
+
+; the compare always succeeds: the value written is the same as the value read
+define_bench dep_cmpxchg_success
+mov     rax, [rsi]
+mov     rcx, rax
+.top:
+%rep 8
+lock cmpxchg [rsi], rcx
+%endrep
+dec     rdi
+jnz     .top
+ret
+
+; the lines may hold different values, so each has its own register and rax
+; is set to it before each cmpxchg
+define_bench indep_cmpxchg_success
+mov     r8,  [rsi      ]
+mov     r9,  [rsi +  64]
+mov     r10, [rsi + 128]
+mov     r11, [rsi + 192]
+.top:
+%rep 2
+mov     rax, r8
+lock cmpxchg [rsi      ], r8
+mov     rax, r9
+lock cmpxchg [rsi +  64], r9
+mov     rax, r10
+lock cmpxchg [rsi + 128], r10
+mov     rax, r11
+lock cmpxchg [rsi + 192], r11
+%endrep
+dec     rdi
+jnz     .top
+ret
+
+; the compare always fails: the expected value is the complement of the current
+; value, reloaded before each cmpxchg since a failed cmpxchg overwrites rax
+define_bench dep_cmpxchg_fail
+mov     rdx, [rsi]
+not     rdx
+.top:
+%rep 8
+mov     rax, rdx
+lock cmpxchg [rsi], rcx
+%endrep
+dec     rdi
+jnz     .top
+ret
+
+define_bench indep_cmpxchg_fail
+mov     rdx, [rsi]
+not     rdx
+.top:
+%rep 2
+mov     rax, rdx
+lock cmpxchg [rsi      ], rcx
+mov     rax, rdx
+lock cmpxchg [rsi +  64], rcx
+mov     rax, rdx
+lock cmpxchg [rsi + 128], rcx
+mov     rax, rdx
+lock cmpxchg [rsi + 192], rcx
+%endrep
+dec     rdi
+jnz     .top
+ret
+
+; 16-byte compare and exchange (needs CX16), always succeeding
+define_bench dep_cmpxchg16b
+push    rbx
+mov     rax, [rsi]
+mov     rdx, [rsi + 8]
+mov     rbx, rax
+mov     rcx, rdx
+.top:
+%rep 8
+lock cmpxchg16b [rsi]
+%endrep
+dec     rdi
+jnz     .top
+pop     rbx
+ret
+
+; as indep_cmpxchg_success, with the 16 bytes of each line in a pair of registers
+; copied into rdx:rax and rcx:rbx before each cmpxchg16b
+%macro cmpxchg16b_line 3
+mov     rax, %2
+mov     rdx, %3
+mov     rbx, %2
+mov     rcx, %3
+lock cmpxchg16b [rsi + %1]
+%endmacro
+
+define_bench indep_cmpxchg16b
+push    rbx
+push    r12
+push    r13
+push    r14
+push    r15
+mov     r8,  [rsi]
+mov     r9,  [rsi + 8]
+mov     r10, [rsi + 64]
+mov     r11, [rsi + 72]
+mov     r12, [rsi + 128]
+mov     r13, [rsi + 136]
+mov     r14, [rsi + 192]
+mov     r15, [rsi + 200]
+.top:
+%rep 2
+cmpxchg16b_line   0, r8,  r9
+cmpxchg16b_line  64, r10, r11
+cmpxchg16b_line 128, r12, r13
+cmpxchg16b_line 192, r14, r15
+%endrep
+dec     rdi
+jnz     .top
+pop     r15
+pop     r14
+pop     r13
+pop     r12
+pop     rbx
+ret
+
+define_bench mfence_only
+.top:
+times 8 mfence
+dec     rdi
+jnz     .top
+ret
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+; memory-level parallelism: mlp_chase_N chases N independent pointer chains
+; at once, one step of each chain per iteration
+;
+; rsi points to an array of N chain pointers, which is updated with the final
+; position of each chain on return, so that successive calls continue the
+; chase rather than revisiting the same lines. The first MLP_REGS chains
+; live in registers, and any further chains are loaded from and stored back
+; to the array on every step (using r15), which adds a store-forwarding delay
+; to those chains, small compared to a cache miss.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+%define mlp_reg0  rax
+%define mlp_reg1  rcx
+%define mlp_reg2  rdx
+%define mlp_reg3  r8
+%define mlp_reg4  r9
+%define mlp_reg5  r10
+%define mlp_reg6  r11
+%define mlp_reg7  rbx
+%define mlp_reg8  rbp
+%define mlp_reg9  r12
+%define mlp_reg10 r13
+%define mlp_reg11 r14
+%define MLP_REGS  12
+%define MLP_MAX_CHAINS 32
+
+%macro define_mlp_chase 1
+define_bench mlp_chase_%1
+push    rbx
+push    rbp
+push    r12
+push    r13
+push    r14
+push    r15
+
+%assign i 0
+%rep %1
+%if i < MLP_REGS
+mov     mlp_reg%[i], [rsi + 8 * i]
+%endif
+%assign i i+1
+%endrep
+
+.top:
+%assign i 0
+%rep %1
+%if i < MLP_REGS
+mov     mlp_reg%[i], [mlp_reg%[i]]
+%else
+mov     r15, [rsi + 8 * i]
+mov     r15, [r15]
+mov     [rsi + 8 * i], r15
+%endif
+%assign i i+1
+%endrep
+dec     rdi
+jnz     .top
+
+%assign i 0
+%rep %1
+%if i < MLP_REGS
+mov     [rsi + 8 * i], mlp_reg%[i]
+%endif
+%assign i i+1
+%endrep
+
+pop     r15
+pop     r14
+pop     r13
+pop     r12
+pop     rbp
+pop     rbx
+ret
+%endmacro
+
+%assign n 1
+%rep MLP_MAX_CHAINS
+define_mlp_chase n
+%assign n n+1
+%endrep
+
+; copy and fill kernels for memory/copy: each iteration copies copy_args.size bytes from copy_args.src to
+; copy_args.dst (or fills copy_args.size bytes at copy_args.dst with 0x5a)
+
+define_bench rep_movsb_copy
+mov     r8, rdi
+mov     r9, rsi
+.top:
+mov     rdi, [r9 + copy_args.dst]
+mov     rsi, [r9 + copy_args.src]
+mov     rcx, [r9 + copy_args.size]
+rep movsb
+dec     r8
+jnz     .top
+ret
+
+define_bench rep_stosb_fill
+mov     r8, rdi
+mov     r9, rsi
+mov     eax, 0x5a
+.top:
+mov     rdi, [r9 + copy_args.dst]
+mov     rcx, [r9 + copy_args.size]
+rep stosb
+dec     r8
+jnz     .top
+ret
+
+; A simple vector copy loop, the way a hand-written memcpy would do it: the first vector is copied unaligned,
+; then the body in 4x unrolled vectors with the destination aligned, then the last vector unaligned (possibly
+; overlapping the body). Copies smaller than one vector are done a byte at a time.
+;
+; %1 name
+; %2 vector width in bytes
+; %3 unaligned move instruction
+; %4 body store instruction (e.g., a non-temporal store)
+; %5 instruction after every copy (e.g., sfence for non-temporal stores), or {}
+; %6-%9 vector registers
+%macro vec_copy 9
+define_bench %1
+.top:
+mov     rdx, [rsi + copy_args.dst]
+mov     rax, [rsi + copy_args.src]
+mov     rcx, [rsi + copy_args.size]
+cmp     rcx, %2
+jb      .small
+
+%3      %6, [rax]
+%3      [rdx], %6
+; advance to the first aligned destination vector
+mov     r8, rdx
+neg     r8
+and     r8, %2 - 1
+add     rax, r8
+add     rdx, r8
+sub     rcx, r8
+
+.body4:
+cmp     rcx, 4 * %2
+jb      .body1
+%3      %6, [rax]
+%3      %7, [rax + %2]
+%3      %8, [rax + 2 * %2]
+%3      %9, [rax + 3 * %2]
+%4      [rdx], %6
+%4      [rdx + %2], %7
+%4      [rdx + 2 * %2], %8
+%4      [rdx + 3 * %2], %9
+add     rax, 4 * %2
+add     rdx, 4 * %2
+sub     rcx, 4 * %2
+jmp     .body4
+
+.body1:
+cmp     rcx, %2
+jb      .tail
+%3      %6, [rax]
+%4      [rdx], %6
+add     rax, %2
+add     rdx, %2
+sub     rcx, %2
+jmp     .body1
+
+.tail:
+%3      %6, [rax + rcx - %2]
+%3      [rdx + rcx - %2], %6
+jmp     .done
+
+.small:
+test    rcx, rcx
+jz      .done
+.byte:
+movzx   r8d, BYTE [rax]
+mov     [rdx], r8b
+inc     rax
+inc     rdx
+dec     rcx
+jnz     .byte
+
+.done:
+%5
+dec     rdi
+jnz     .top
+vzeroupper
+ret
+%endmacro
+
+; The fill version of vec_copy.
+;
+; %1 name
+; %2 vector width in bytes
+; %3 unaligned move instruction
+; %4 body store instruction
+; %5 instruction after every fill, or {}
+; %6 vector register
+; %7 instruction to broadcast eax to %6
+%macro vec_fill 7
+define_bench %1
+mov     eax, 0x5a5a5a5a
+%7
+.top:
+mov     rdx, [rsi + copy_args.dst]
+mov     rcx, [rsi + copy_args.size]
+cmp     rcx, %2
+jb      .small
+
+%3      [rdx], %6
+lea     r8, [rdx + rcx - %2]   ; the last vector
+mov     r9, rdx
+neg     r9
+and     r9, %2 - 1
+add     rdx, r9
+sub     rcx, r9
+
+.body4:
+cmp     rcx, 4 * %2
+jb      .body1
+%4      [rdx], %6
+%4      [rdx + %2], %6
+%4      [rdx + 2 * %2], %6
+%4      [rdx + 3 * %2], %6
+add     rdx, 4 * %2
+sub     rcx, 4 * %2
+jmp     .body4
+
+.body1:
+cmp     rcx, %2
+jb      .tail
+%4      [rdx], %6
+add     rdx, %2
+sub     rcx, %2
+jmp     .body1
+
+.tail:
+%3      [r8], %6
+jmp     .done
+
+.small:
+test    rcx, rcx
+jz      .done
+.byte:
+mov     [rdx], al
+inc     rdx
+dec     rcx
+jnz     .byte
+
+.done:
+%5
+dec     rdi
+jnz     .top
+vzeroupper
+ret
+%endmacro
+
+vec_copy avx2_copy,      32, vmovdqu,   vmovdqu,   {},     ymm0,  ymm1,  ymm2,  ymm3
+vec_copy avx2_copy_nt,   32, vmovdqu,   vmovntdq,  sfence, ymm0,  ymm1,  ymm2,  ymm3
+vec_copy avx512_copy,    64, vmovdqu64, vmovdqu64, {},     zmm16, zmm17, zmm18, zmm19
+vec_copy avx512_copy_nt, 64, vmovdqu64, vmovntdq,  sfence, zmm16, zmm17, zmm18, zmm19
+
+%macro broadcast_ymm0 0
+vmovd           xmm0, eax
+vpbroadcastd    ymm0, xmm0
+%endmacro
+
+%macro broadcast_zmm16 0
+vpbroadcastd    zmm16, eax
+%endmacro
+
+vec_fill avx2_fill,      32, vmovdqu,   vmovdqu,   {},     ymm0,  broadcast_ymm0
+vec_fill avx2_fill_nt,   32, vmovdqu,   vmovntdq,  sfence, ymm0,  broadcast_ymm0
+vec_fill avx512_fill,    64, vmovdqu64, vmovdqu64, {},     zmm16, broadcast_zmm16
+vec_fill avx512_fill_nt, 64, vmovdqu64, vmovntdq,  sfence, zmm16, broadcast_zmm16
+
+
+; gather and scatter kernels for vector/gather: each iteration does one gather (or scatter) using the next vector
+; of indices from gather_args.indices, wrapping around with gather_args.mask (the size of the index table - 1)
+
+; %1 name
+; %2 the gather instruction, gathering into ymm0 with indices in ymm1 and mask ymm2
+%macro avx2_gather 2
+define_bench %1
+mov     rdx, [rsi + gather_args.base]
+mov     rcx, [rsi + gather_args.indices]
+mov     r8,  [rsi + gather_args.mask]
+xor     eax, eax
+.top:
+vmovdqu     ymm1, [rcx + rax]
+vpcmpeqd    ymm2, ymm2, ymm2    ; the gather clears the mask
+vpxor       ymm0, ymm0, ymm0    ; the gather merges into the destination, so break the dependency
+%2
+add     rax, 32
+and     rax, r8
+dec     rdi
+jnz     .top
+vzeroupper
+ret
+%endmacro
+
+; %1 name
+; %2 the gather or scatter instruction, with data in zmm16, indices in zmm17 and mask k1
+%macro avx512_gather 2
+define_bench %1
+mov     rdx, [rsi + gather_args.base]
+mov     rcx, [rsi + gather_args.indices]
+mov     r8,  [rsi + gather_args.mask]
+xor     eax, eax
+.top:
+vmovdqu64   zmm17, [rcx + rax]
+kxnorw      k1, k1, k1
+vpxord      zmm16, zmm16, zmm16
+%2
+add     rax, 64
+and     rax, r8
+dec     rdi
+jnz     .top
+vzeroupper
+ret
+%endmacro
+
+avx2_gather   avx2_gather_dd,    {vpgatherdd ymm0, [rdx + ymm1 * 4], ymm2}
+avx2_gather   avx2_gather_qq,    {vpgatherqq ymm0, [rdx + ymm1 * 8], ymm2}
+avx512_gather avx512_gather_dd,  {vpgatherdd zmm16{k1}, [rdx + zmm17 * 4]}
+avx512_gather avx512_gather_qq,  {vpgatherqq zmm16{k1}, [rdx + zmm17 * 8]}
+avx512_gather avx512_scatter_dd, {vpscatterdd [rdx + zmm17 * 4]{k1}, zmm16}
+avx512_gather avx512_scatter_qq, {vpscatterqq [rdx + zmm17 * 8]{k1}, zmm16}
+
+
+; masked load and store kernels for vector/masked: the pointer is mask_args.ptr, and the mask is either the
+; vector mask_args.vmask (for the AVX/AVX2 instructions) or mask_args.kmask (for AVX-512)
+
+%macro mask_ymm 0
+vmovdqu ymm1, [rsi + mask_args.vmask]
+vpxor   ymm0, ymm0, ymm0
+%endmacro
+
+%macro mask_k 0
+kmovw   k1, [rsi + mask_args.kmask]
+vpxord  zmm16, zmm16, zmm16
+%endmacro
+
+; throughput of independent masked loads or stores
+; %1 name
+; %2 the mask setup macro
+; %3 the masked instruction, with the pointer in rdx
+%macro masked_tput 3
+define_bench %1
+mov     rdx, [rsi + mask_args.ptr]
+%2
+.top:
+%rep 8
+%3
+%endrep
+dec     rdi
+jnz     .top
+vzeroupper
+ret
+%endmacro
+
+; latency of a masked store (of zeros) followed by a dependent 8-byte load from the same address
+; %1 name
+; %2 the mask setup macro
+; %3 the masked store, with the pointer in rdx
+%macro masked_store_load 3
+define_bench %1
+mov     rdx, [rsi + mask_args.ptr]
+%2
+.top:
+%3
+mov     rax, [rdx]
+add     rdx, rax    ; the memory is all zeros, so this just makes the next store address depend on the load
+dec     rdi
+jnz     .top
+vzeroupper
+ret
+%endmacro
+
+masked_tput vmaskmovps_load,      mask_ymm, {vmaskmovps ymm0, ymm1, [rdx]}
+masked_tput vmaskmovps_store,     mask_ymm, {vmaskmovps [rdx], ymm1, ymm0}
+masked_tput vpmaskmovd_load,      mask_ymm, {vpmaskmovd ymm0, ymm1, [rdx]}
+masked_tput vpmaskmovd_store,     mask_ymm, {vpmaskmovd [rdx], ymm1, ymm0}
+masked_tput vmaskmovpd_load,      mask_ymm, {vmaskmovpd ymm0, ymm1, [rdx]}
+masked_tput vmaskmovpd_store,     mask_ymm, {vmaskmovpd [rdx], ymm1, ymm0}
+masked_tput vpmaskmovq_load,      mask_ymm, {vpmaskmovq ymm0, ymm1, [rdx]}
+masked_tput vpmaskmovq_store,     mask_ymm, {vpmaskmovq [rdx], ymm1, ymm0}
+masked_tput avx512_masked_load,   mask_k,   {vmovdqu32 zmm16{k1}{z}, [rdx]}
+masked_tput avx512_masked_store,  mask_k,   {vmovdqu32 [rdx]{k1}, zmm16}
+
+masked_store_load vmaskmovps_store_load,    mask_ymm, {vmaskmovps [rdx], ymm1, ymm0}
+masked_store_load vpmaskmovd_store_load,    mask_ymm, {vpmaskmovd [rdx], ymm1, ymm0}
+masked_store_load vmaskmovpd_store_load,    mask_ymm, {vmaskmovpd [rdx], ymm1, ymm0}
+masked_store_load vpmaskmovq_store_load,    mask_ymm, {vpmaskmovq [rdx], ymm1, ymm0}
+masked_store_load avx512_masked_store_load, mask_k,   {vmovdqu32 [rdx]{k1}, zmm16}
+
+
 ud2
 